@@ -0,0 +1,116 @@
+#include <Logger.hpp>
+#include <cmath>
+#include <cstdint>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+#include "AABBTree.hpp"
+#include "Measure.hpp"
+
+// The objects are spread with a constant density, so the queries return about as many objects at every size
+static constexpr float objectDensity = 0.01f;
+// One object out of ten moves each frame
+static constexpr uint32_t movingStride = 10;
+static constexpr unsigned queryCount = 100;
+
+static void benchmark(uint32_t objectCount, unsigned frameCount)
+{
+    std::mt19937 rng(objectCount);
+    const float halfSize = 0.5f * std::cbrt(objectCount / objectDensity);
+    std::uniform_real_distribution<float> position(-halfSize, halfSize);
+    std::uniform_real_distribution<float> extent(0.5f, 2.0f);
+    std::uniform_real_distribution<float> speed(-0.2f, 0.2f);
+
+    std::vector<AABB> boxes(objectCount);
+    std::vector<glm::vec3> velocities(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        const glm::vec3 center(position(rng), position(rng), position(rng));
+        boxes[i] = {.min = center - glm::vec3(extent(rng)), .max = center + glm::vec3(extent(rng))};
+        velocities[i] = glm::vec3(speed(rng), speed(rng), speed(rng));
+    }
+
+    AABBTree tree;
+    std::vector<int32_t> proxies(objectCount);
+    const double buildTime = measure(3, [&] {
+        tree.clear();
+        tree.createProxies(boxes, 0, proxies);
+    });
+
+    // Each call moves a different slice of the objects, as successive frames would
+    uint32_t frame = 0;
+    uint32_t reinserted = 0;
+    const auto update = [&] {
+        for (uint32_t i = frame++ % movingStride; i < objectCount; i += movingStride) {
+            boxes[i].min += velocities[i];
+            boxes[i].max += velocities[i];
+            reinserted += tree.moveProxy(proxies[i], boxes[i], velocities[i]);
+        }
+    };
+    // The first move of an object always reinserts it, as the bulk build does not predict the displacement
+    for (uint32_t i = 0; i < movingStride; i++) { update(); }
+    reinserted = 0;
+    const double updateTime = measure(frameCount, update);
+    reinserted /= frameCount + 1;
+
+    const glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    std::vector<Frustum> frustums(queryCount);
+    std::vector<AABB> queryBoxes(queryCount);
+    std::vector<Ray> rays(queryCount);
+    for (unsigned q = 0; q < queryCount; q++) {
+        const glm::vec3 eye(position(rng), position(rng), position(rng));
+        const glm::vec3 target(position(rng), position(rng), position(rng));
+        frustums[q] = Frustum::fromViewProj(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+        queryBoxes[q] = {.min = eye - glm::vec3(10.0f), .max = eye + glm::vec3(10.0f)};
+        rays[q] = {.origin = eye, .direction = glm::normalize(target - eye), .maxDistance = 100.0f};
+    }
+
+    uint64_t visible = 0;
+    const double frustumTime = measure(frameCount, [&] {
+        for (const auto &frustum: frustums) {
+            tree.query(frustum, [&](int32_t) {
+                visible++;
+                return true;
+            });
+        }
+    });
+    const double linearFrustumTime = measure(3, [&] {
+        for (const auto &frustum: frustums) {
+            for (const auto &box: boxes) { visible += frustum.intersects(box); }
+        }
+    });
+    const double boxTime = measure(frameCount, [&] {
+        for (const auto &queryBox: queryBoxes) {
+            tree.query(queryBox, [&](int32_t) {
+                visible++;
+                return true;
+            });
+        }
+    });
+    const double rayTime = measure(frameCount, [&] {
+        for (const auto &ray: rays) {
+            tree.rayCast(ray, [&](int32_t proxyID, const Ray &current) {
+                return current.intersect(boxes[tree.getUserData(proxyID)]);
+            });
+        }
+    });
+
+    logger->info("AABBTree") << objectCount << " objects: build " << buildTime << "ms, height " << tree.getHeight()
+                             << ", area ratio " << tree.getAreaRatio();
+    LOGGER_ENDL;
+    logger->info("AABBTree") << objectCount << " objects: update of " << objectCount / movingStride << " objects "
+                             << updateTime << "ms/frame, " << reinserted << " reinsertions/frame";
+    LOGGER_ENDL;
+    logger->info("AABBTree") << objectCount << " objects: " << queryCount << " frustum queries " << frustumTime
+                             << "ms (linear scan " << linearFrustumTime << "ms), " << queryCount << " box queries "
+                             << boxTime << "ms, " << queryCount << " ray casts " << rayTime << "ms";
+    LOGGER_ENDL;
+}
+
+int main()
+{
+    benchmark(10'000, 100);
+    benchmark(100'000, 30);
+    benchmark(1'000'000, 10);
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <Logger.hpp>
+#include <iostream>
+
+Logger *logger = nullptr;
+
+__attribute__((constructor)) void ctor()
+{
+    logger = new Logger(std::cout);
+    logger->start(Logger::Level::Info);
+}
+__attribute__((destructor)) void dtor() { delete logger; }
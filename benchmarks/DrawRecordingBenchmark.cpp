@@ -0,0 +1,228 @@
+#include <Logger.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <vulkan/vulkan.hpp>
+
+#include "Measure.hpp"
+#include "PipelineBuilder.hpp"
+#include "VulkanLoader.hpp"
+#include "types/VulkanException.hpp"
+#include "vk_init.hpp"
+#include "vk_utils.hpp"
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE;
+
+static constexpr unsigned frameCount = 100;
+static constexpr uint32_t maxBatches = 10'000;
+
+// Headless device with an empty render pass, and a pipeline made of a vertex shader. The draws are recorded like
+// drawFrame records them, but never submitted, so any device works, a software one included.
+class RecordingContext : public VulkanLoader
+{
+public:
+    RecordingContext();
+    ~RecordingContext();
+
+    // One indirect draw per batch, or as few multi draws as maxDrawIndirectCount allows
+    void record(uint32_t batchCount, bool bMultiDraw);
+
+    constexpr bool isMultiDrawSupported() const noexcept { return bMultiDrawIndirectSupported; }
+
+private:
+    vk::PhysicalDevice physicalDevice;
+    bool bMultiDrawIndirectSupported = false;
+    uint32_t maxDrawIndirectCount = 1;
+
+    vk::Buffer indirectBuffer;
+    vk::DeviceMemory indirectMemory;
+    vk::RenderPass renderPass;
+    vk::Framebuffer framebuffer;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline pipeline;
+    vk::CommandPool commandPool;
+    vk::CommandBuffer cmd;
+};
+
+RecordingContext::RecordingContext()
+{
+    vk::ApplicationInfo appInfo{
+        .pApplicationName = "DrawRecordingBenchmark",
+        .apiVersion = VK_API_VERSION_1_2,
+    };
+    vk::InstanceCreateInfo instanceInfo{
+        .pApplicationInfo = &appInfo,
+    };
+    createInstance(instanceInfo);
+
+    const auto physicalDevices = instance.enumeratePhysicalDevices();
+    if (physicalDevices.empty()) throw VulkanException("no Vulkan device found");
+    physicalDevice = physicalDevices.front();
+
+    const auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+    const auto graphicsFamily = std::ranges::find_if(queueFamilies, [](const vk::QueueFamilyProperties &family) {
+        return bool(family.queueFlags & vk::QueueFlagBits::eGraphics);
+    });
+    if (graphicsFamily == queueFamilies.end()) throw VulkanException("no graphics queue found");
+    const uint32_t queueFamily = std::distance(queueFamilies.begin(), graphicsFamily);
+
+    const auto supportedFeatures = physicalDevice.getFeatures();
+    bMultiDrawIndirectSupported = supportedFeatures.multiDrawIndirect;
+    if (bMultiDrawIndirectSupported) {
+        maxDrawIndirectCount = physicalDevice.getProperties().limits.maxDrawIndirectCount;
+    }
+
+    const float priority = 1.0f;
+    const auto queueInfo = vk_init::populateDeviceQueueCreateInfo(1, queueFamily, priority);
+    const vk::PhysicalDeviceFeatures deviceFeature{
+        .multiDrawIndirect = supportedFeatures.multiDrawIndirect,
+    };
+    vk::DeviceCreateInfo deviceInfo{
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queueInfo,
+        .pEnabledFeatures = &deviceFeature,
+    };
+    createLogicalDevice(physicalDevice, deviceInfo);
+
+    // The commands are never read, the buffer is both the index and the indirect buffer
+    indirectBuffer = device.createBuffer({
+        .size = maxBatches * sizeof(vk::DrawIndexedIndirectCommand),
+        .usage = vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eIndexBuffer,
+        .sharingMode = vk::SharingMode::eExclusive,
+    });
+    const auto requirements = device.getBufferMemoryRequirements(indirectBuffer);
+    indirectMemory = device.allocateMemory({
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = vk_utils::findMemoryType(physicalDevice, requirements.memoryTypeBits,
+                                                    vk::MemoryPropertyFlagBits::eDeviceLocal),
+    });
+    device.bindBufferMemory(indirectBuffer, indirectMemory, 0);
+
+    const vk::SubpassDescription subpass{
+        .pipelineBindPoint = vk::PipelineBindPoint::eGraphics,
+    };
+    renderPass = device.createRenderPass({
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+    });
+    framebuffer = device.createFramebuffer({
+        .renderPass = renderPass,
+        .width = 1,
+        .height = 1,
+        .layers = 1,
+    });
+
+    pipelineLayout = device.createPipelineLayout(vk_init::populateVkPipelineLayoutCreateInfo({}, {}));
+    auto vertShaderModule =
+        vk_utils::createShaderModule(device, vk_utils::readFile("shaders/draw_recording.vert.spv"));
+    PipelineBuilder builder;
+    builder.pipelineLayout = pipelineLayout;
+    builder.shaderStages.push_back(
+        vk_init::populateVkPipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex, vertShaderModule));
+    builder.inputAssembly =
+        vk_init::populateVkPipelineInputAssemblyCreateInfo(vk::PrimitiveTopology::eTriangleList, VK_FALSE);
+    builder.multisampling = vk_init::populateVkPipelineMultisampleStateCreateInfo();
+    builder.depthStencil = vk_init::populateVkPipelineDepthStencilStateCreateInfo();
+    builder.dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    builder.rasterizer = vk_init::populateVkPipelineRasterizationStateCreateInfo(vk::PolygonMode::eFill);
+    pipeline = builder.build(device, renderPass);
+    device.destroy(vertShaderModule);
+    if (!pipeline) throw VulkanException("failed to create the pipeline");
+
+    commandPool = device.createCommandPool({
+        .flags = vk::CommandPoolCreateFlagBits::eTransient,
+        .queueFamilyIndex = queueFamily,
+    });
+    cmd = device
+              .allocateCommandBuffers({
+                  .commandPool = commandPool,
+                  .level = vk::CommandBufferLevel::ePrimary,
+                  .commandBufferCount = 1,
+              })
+              .front();
+}
+
+RecordingContext::~RecordingContext()
+{
+    device.destroy(commandPool);
+    device.destroy(pipeline);
+    device.destroy(pipelineLayout);
+    device.destroy(framebuffer);
+    device.destroy(renderPass);
+    device.destroy(indirectBuffer);
+    device.free(indirectMemory);
+    device.destroy();
+    instance.destroy();
+}
+
+void RecordingContext::record(uint32_t batchCount, bool bMultiDraw)
+{
+    device.resetCommandPool(commandPool);
+
+    const vk::CommandBufferBeginInfo beginInfo{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+    };
+    const vk::RenderPassBeginInfo renderPassInfo{
+        .renderPass = renderPass,
+        .framebuffer = framebuffer,
+        .renderArea =
+            {
+                .extent = {.width = 1, .height = 1},
+            },
+    };
+    const vk::Viewport viewport{
+        .width = 1.0f,
+        .height = 1.0f,
+        .maxDepth = 1.0f,
+    };
+
+    VK_TRY(cmd.begin(&beginInfo));
+    cmd.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+    cmd.setViewport(0, viewport);
+    cmd.setScissor(0, renderPassInfo.renderArea);
+    cmd.bindIndexBuffer(indirectBuffer, 0, vk::IndexType::eUint32);
+    if (bMultiDraw) {
+        for (uint32_t b = 0; b < batchCount; b += maxDrawIndirectCount) {
+            cmd.drawIndexedIndirect(indirectBuffer, b * sizeof(vk::DrawIndexedIndirectCommand),
+                                    std::min(batchCount - b, maxDrawIndirectCount),
+                                    sizeof(vk::DrawIndexedIndirectCommand));
+        }
+    } else {
+        for (uint32_t b = 0; b < batchCount; b++) {
+            cmd.drawIndexedIndirect(indirectBuffer, b * sizeof(vk::DrawIndexedIndirectCommand), 1,
+                                    sizeof(vk::DrawIndexedIndirectCommand));
+        }
+    }
+    cmd.endRenderPass();
+    cmd.end();
+}
+
+int main()
+{
+    try {
+        RecordingContext context;
+        if (!context.isMultiDrawSupported()) {
+            logger->warn("DrawRecording") << "multiDrawIndirect is not supported, only the loop is measured";
+            LOGGER_ENDL;
+        }
+        for (const uint32_t batchCount: {1u, 100u, maxBatches}) {
+            const double loopTime = measure(frameCount, [&] { context.record(batchCount, false); });
+            if (context.isMultiDrawSupported()) {
+                const double multiDrawTime = measure(frameCount, [&] { context.record(batchCount, true); });
+                logger->info("DrawRecording") << batchCount << " batches: " << loopTime
+                                              << "ms with one draw per batch, " << multiDrawTime
+                                              << "ms with multi draw indirect";
+            } else {
+                logger->info("DrawRecording") << batchCount << " batches: " << loopTime << "ms with one draw per batch";
+            }
+            LOGGER_ENDL;
+        }
+    } catch (const std::exception &e) {
+        logger->err("DrawRecording") << e.what();
+        LOGGER_ENDL;
+        return 1;
+    }
+    return 0;
+}
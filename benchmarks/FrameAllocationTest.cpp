@@ -0,0 +1,313 @@
+#include <Logger.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <glm/gtc/matrix_transform.hpp>
+#include <memory_resource>
+#include <new>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "FrameArena.hpp"
+#include "JobSystem.hpp"
+#include "Measure.hpp"
+#include "OcclusionRasterizer.hpp"
+#include "types/RenderStats.hpp"
+#include "types/SampleHistory.hpp"
+#include "types/Scene.hpp"
+#include "types/StringMap.hpp"
+
+// Every allocation of the global heap is counted, from any thread, while bCounting is set
+static std::atomic<bool> bCounting = false;
+static std::atomic<uint64_t> allocationCount = 0;
+
+static void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+{
+    if (bCounting.load(std::memory_order_relaxed)) allocationCount.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc expects a multiple of the alignment
+    size = (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    if (void *p = std::aligned_alloc(alignment, size)) return p;
+    throw std::bad_alloc();
+}
+
+static void *allocate(size_t size, size_t alignment, const std::nothrow_t &) noexcept
+{
+    try {
+        return allocate(size, alignment);
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+// Every form is replaced, so none of them reaches the default implementation, which may not forward to the others
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, std::align_val_t alignment) { return allocate(size, size_t(alignment)); }
+void *operator new[](size_t size, std::align_val_t alignment) { return allocate(size, size_t(alignment)); }
+void *operator new(size_t size, const std::nothrow_t &tag) noexcept
+{
+    return allocate(size, alignof(std::max_align_t), tag);
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return allocate(size, alignof(std::max_align_t), tag);
+}
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept
+{
+    return allocate(size, size_t(alignment), tag);
+}
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept
+{
+    return allocate(size, size_t(alignment), tag);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+
+// As MAX_FRAME_FRAME_IN_FLIGHT
+static constexpr unsigned framesInFlight = 3;
+// As Application::uploadGrainSize and Application::minBatchesPerRecordingJob
+static constexpr uint32_t uploadGrainSize = 256;
+static constexpr uint32_t minBatchesPerRecordingJob = 32;
+static constexpr uint32_t recordingPools = 4;
+static constexpr unsigned warmupFrames = 2 * framesInFlight;
+// Enough for the profiler histories to wrap around
+static constexpr unsigned steadyFrames = 2 * SampleHistory::historySize;
+static constexpr uint32_t meshCount = 16;
+static constexpr uint32_t objectCount = 4096;
+static constexpr uint32_t vehicleParts = 50;
+static constexpr uint32_t profilerScopes = 4;
+
+struct DrawCommand {
+    uint32_t indexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+};
+
+// The CPU side of Application::drawFrame, without a device. The scene, the scene graph, the occlusion rasterizer, the
+// job system, the frame arenas, the pending upload ranges, the render statistics and the GPU profiler histories are
+// the engine's own. buildIndirectBuffers and recordDrawCommands are reproduced step by step, with plain vectors in
+// place of the mapped buffers and an index in place of each command buffer: the Vulkan calls, ImGui and the
+// GPUProfiler query pools are not covered.
+class FrameSimulation
+{
+public:
+    FrameSimulation();
+
+    void frame(uint32_t frameNumber);
+
+private:
+    struct Frame {
+        FrameArena arena;
+        RenderStats stats;
+    };
+
+    JobSystem jobSystem;
+    OcclusionRasterizer rasterizer;
+    std::array<Frame, framesInFlight> frames;
+    std::array<Scene::DirtyRange, framesInFlight> pendingUploads;
+    RenderStats renderStats;
+    std::array<SampleHistory, profilerScopes> profilerHistories;
+    std::vector<float> sortedSamples;
+    Scene scene;
+    StringMap<uint32_t> meshIndexCounts;
+    StringMap<OcclusionRasterizer::Mesh> occluderMeshes;
+    SceneGraph::NodeID vehicle = SceneGraph::invalidNode;
+
+    std::vector<gpuObject::UniformBufferObject> objectBuffer;
+    std::vector<uint32_t> instanceBuffer;
+    std::vector<DrawCommand> indirectBuffer;
+};
+
+FrameSimulation::FrameSimulation()
+    : jobSystem(recordingPools), rasterizer(jobSystem), objectBuffer(objectCount), instanceBuffer(objectCount)
+{
+    sortedSamples.reserve(SampleHistory::historySize);
+    const OcclusionRasterizer::Mesh wall{
+        .positions = {{-1.0f, -1.0f, 0.0f}, {1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {-1.0f, 1.0f, 0.0f}},
+        .indices = {0, 1, 2, 0, 2, 3},
+    };
+    for (uint32_t m = 0; m < meshCount; m++) {
+        const std::string name = "mesh_" + std::to_string(m);
+        meshIndexCounts[name] = 36 * (m + 1);
+        occluderMeshes[name] = wall;
+        scene.setMeshBounds(name, {.min = glm::vec3(-1.0f), .max = glm::vec3(1.0f)});
+    }
+
+    // Sorted by mesh, as a loaded level
+    std::vector<RenderObject> objects(objectCount);
+    auto mesh = meshIndexCounts.begin();
+    for (uint32_t i = 0; i < objectCount; i++) {
+        if (i > 0 && i % (objectCount / meshCount) == 0) ++mesh;
+        const glm::vec3 position(float(i % 64) * 3.0f - 96.0f, 0.0f, -float(i / 64) * 3.0f);
+        objects[i] = {
+            .meshID = mesh->first,
+            .ubo =
+                {
+                    .transform =
+                        {
+                            .translation = glm::translate(glm::mat4(1.0f), position),
+                            .rotation = glm::mat4(1.0f),
+                            .scale = glm::mat4(1.0f),
+                        },
+                    .textureIndex = 0,
+                },
+            .bOccluder = (i % 97 == 0),
+        };
+    }
+    scene.addObjects(std::move(objects));
+
+    // A vehicle and its parts, moved through the scene graph
+    vehicle = scene.attachObject(0);
+    for (uint32_t i = 1; i <= vehicleParts; i++) { scene.attachObject(i, vehicle); }
+}
+
+void FrameSimulation::frame(uint32_t frameNumber)
+{
+    auto &frame = frames[frameNumber % framesInFlight];
+
+    // The previous submission of this slot is done: its statistics and its GPU timings are read back
+    if (frameNumber >= framesInFlight) {
+        renderStats = frame.stats;
+        for (uint32_t i = 0; i < profilerScopes; i++) {
+            profilerHistories[i].add(0.1f * (i + 1) + 0.001f * (frameNumber % 7), sortedSamples);
+        }
+    }
+    frame.stats = {
+        .frameNumber = frameNumber,
+        .fFrameTime = 16.0f,
+    };
+    frame.arena.reset();
+
+    // Simulation: the vehicle and a few free objects move
+    const glm::vec3 offset(0.0f, 0.0f, -0.1f * frameNumber);
+    scene.getGraph().setLocalTransform(vehicle, glm::translate(glm::mat4(1.0f), offset));
+    for (uint32_t i = vehicleParts + 1; i < objectCount; i += 64) {
+        auto ubo = scene.getObject(i).ubo;
+        ubo.transform.translation = glm::translate(ubo.transform.translation, glm::vec3(0.0f, 0.01f, 0.0f));
+        scene.updateObject(i, ubo);
+    }
+
+    // Every frame in flight has its own object buffer
+    const auto modifiedObjects = scene.update();
+    for (auto &range: pendingUploads) range.add(modifiedObjects);
+    auto &upload = pendingUploads[frameNumber % framesInFlight];
+    upload.last = std::min<uint32_t>(upload.last, scene.getNbOfObject());
+    if (!upload.isEmpty()) {
+        jobSystem.parallelFor(upload.last - upload.first, uploadGrainSize, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = upload.first + begin; i < upload.first + end; i++) {
+                objectBuffer[i] = scene.getObject(i).ubo;
+            }
+        });
+        frame.stats.uploadedBytes += (upload.last - upload.first) * sizeof(gpuObject::UniformBufferObject);
+    }
+    upload = {};
+
+    // buildIndirectBuffers, with the CPU occlusion culling
+    const glm::mat4 viewproj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 300.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f, 0.0f, -50.0f),
+                                           glm::vec3(0.0f, 1.0f, 0.0f));
+    rasterizer.beginFrame(viewproj);
+    for (uint32_t i = 0; i < scene.getNbOfObject(); i++) {
+        const auto &object = scene.getObject(i);
+        if (object.bOccluder) rasterizer.addOccluder(occluderMeshes.at(object.meshID), object.getModelMatrix());
+    }
+    rasterizer.rasterize();
+
+    const auto &batches = scene.getDrawBatch();
+    indirectBuffer.resize(batches.size());
+    for (uint32_t b = 0; b < batches.size(); b++) {
+        const auto &draw = batches[b];
+        indirectBuffer[b] = {
+            .indexCount = meshIndexCounts.at(draw.meshId),
+            .instanceCount = 0,
+            .firstIndex = 0,
+            .vertexOffset = 0,
+            .firstInstance = draw.first,
+        };
+        for (uint32_t i = draw.first; i < draw.first + draw.count; i++) {
+            const auto &object = scene.getObject(i);
+            if (!object.bOccluder && !rasterizer.isVisible(scene.getSpatialIndex().getFatAABB(object.proxyID))) {
+                continue;
+            }
+            instanceBuffer[draw.first + indirectBuffer[b].instanceCount++] = i;
+        }
+        frame.stats.instances += indirectBuffer[b].instanceCount;
+        frame.stats.indices += uint64_t(indirectBuffer[b].instanceCount) * indirectBuffer[b].indexCount;
+    }
+    frame.stats.triangles = frame.stats.indices / 3;
+
+    // recordDrawCommands: the batches split between the recording jobs, their data in the frame arena
+    const uint32_t nbOfBatch = batches.size();
+    const uint32_t nbOfJobs = std::clamp<uint32_t>(
+        (nbOfBatch + minBatchesPerRecordingJob - 1) / minBatchesPerRecordingJob, 1, recordingPools);
+    const uint32_t batchesPerJob = (nbOfBatch + nbOfJobs - 1) / nbOfJobs;
+    std::pmr::vector<uint32_t> commands(frame.arena.getResource());
+    commands.reserve(nbOfJobs + 1);
+    for (uint32_t job = 0; job < nbOfJobs; job++) { commands.push_back(job); }
+
+    std::pmr::vector<uint32_t> drawCalls(nbOfJobs, 0, frame.arena.getResource());
+    JobSystem::Counter counter;
+    for (uint32_t job = 0; job < nbOfJobs; job++) {
+        jobSystem.schedule(
+            [&, job] {
+                const uint32_t firstBatch = std::min(job * batchesPerJob, nbOfBatch);
+                const uint32_t batchCount = std::min(batchesPerJob, nbOfBatch - firstBatch);
+                for (uint32_t b = firstBatch; b < firstBatch + batchCount; b++) {
+                    drawCalls[job] += (indirectBuffer[b].instanceCount > 0);
+                }
+            },
+            &counter);
+    }
+    jobSystem.wait(counter);
+    frame.stats.drawCalls += std::accumulate(drawCalls.begin(), drawCalls.end(), 0u);
+    frame.stats.drawCommands += nbOfBatch;
+    frame.stats.pipelineBinds += nbOfJobs;
+    frame.stats.descriptorBinds += nbOfJobs * 2;
+    CHECK(commands.size() == nbOfJobs);
+    CHECK(frame.stats.drawCalls > 0);
+}
+
+int main()
+{
+    try {
+        FrameSimulation simulation;
+        uint32_t frameNumber = 0;
+
+        // The first frames size the arenas, the batches and the rasterizer bins
+        bCounting = true;
+        for (unsigned i = 0; i < warmupFrames; i++) { simulation.frame(frameNumber++); }
+        const uint64_t warmupAllocations = allocationCount.exchange(0);
+
+        for (unsigned i = 0; i < steadyFrames; i++) { simulation.frame(frameNumber++); }
+        bCounting = false;
+
+        logger->info("FrameAllocation") << warmupAllocations << " allocations in the first " << warmupFrames
+                                        << " frames, " << allocationCount.load() << " in the next " << steadyFrames;
+        LOGGER_ENDL;
+        // Otherwise the counter is not hooked
+        CHECK(warmupAllocations > 0);
+        CHECK(allocationCount == 0);
+    } catch (const std::exception &e) {
+        bCounting = false;
+        logger->err("FrameAllocation") << e.what();
+        LOGGER_ENDL;
+        return 1;
+    }
+    return 0;
+}
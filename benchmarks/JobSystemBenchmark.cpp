@@ -0,0 +1,114 @@
+#include <Logger.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "Measure.hpp"
+
+static constexpr unsigned frameCount = 20;
+static constexpr uint32_t elementCount = 1 << 20;
+static constexpr uint32_t jobCount = 4096;
+static constexpr uint32_t waveCount = 64;
+static constexpr uint32_t jobsPerWave = 64;
+
+// About as expensive as updating an object
+static float work(uint32_t index)
+{
+    float value = index;
+    for (unsigned i = 0; i < 32; i++) { value = std::sqrt(value * value + 1.0f); }
+    return value;
+}
+
+struct Timings {
+    double parallelFor = 0.0;
+    double smallJobs = 0.0;
+    double dependencies = 0.0;
+};
+
+static Timings benchmark(unsigned nbOfThreads, const std::vector<float> &expected)
+{
+    JobSystem jobSystem(nbOfThreads);
+    Timings timings;
+
+    std::vector<float> results(elementCount);
+    timings.parallelFor = measure(frameCount, [&] {
+        jobSystem.parallelFor(elementCount, 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) { results[i] = work(i); }
+        });
+    });
+    CHECK(results == expected);
+
+    // Scheduling overhead: a job per chunk of 256 elements
+    std::vector<float> sums(jobCount);
+    timings.smallJobs = measure(frameCount, [&] {
+        JobSystem::Counter counter;
+        for (uint32_t job = 0; job < jobCount; job++) {
+            jobSystem.schedule(
+                [&, job] {
+                    float sum = 0.0f;
+                    for (uint32_t i = job * 256; i < (job + 1) * 256; i++) { sum += expected[i]; }
+                    sums[job] = sum;
+                },
+                &counter);
+        }
+        jobSystem.wait(counter);
+    });
+    CHECK(sums[jobCount - 1] > 0.0f);
+
+    // Waves of jobs, each one waiting on the previous
+    std::atomic<uint32_t> done = 0;
+    timings.dependencies = measure(frameCount, [&] {
+        std::array<JobSystem::Counter, waveCount> waves;
+        for (uint32_t wave = 0; wave < waveCount; wave++) {
+            for (uint32_t job = 0; job < jobsPerWave; job++) {
+                const auto run = [&, job] { done.fetch_add(work(job) > 0.0f, std::memory_order_relaxed); };
+                if (wave == 0) {
+                    jobSystem.schedule(run, &waves[wave]);
+                } else {
+                    jobSystem.scheduleAfter(waves[wave - 1], run, &waves[wave]);
+                }
+            }
+        }
+        for (auto &wave: waves) { jobSystem.wait(wave); }
+    });
+    CHECK(done == (frameCount + 1) * waveCount * jobsPerWave);
+
+    return timings;
+}
+
+int main()
+{
+    try {
+        std::vector<float> expected(elementCount);
+        for (uint32_t i = 0; i < elementCount; i++) { expected[i] = work(i); }
+
+        const unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<unsigned> threadCounts;
+        for (unsigned n = 1; n < maxThreads; n *= 2) { threadCounts.push_back(n); }
+        threadCounts.push_back(maxThreads);
+
+        Timings reference;
+        for (const unsigned nbOfThreads: threadCounts) {
+            const Timings timings = benchmark(nbOfThreads, expected);
+            if (nbOfThreads == 1) reference = timings;
+            logger->info("JobSystem") << nbOfThreads << " threads: parallelFor " << timings.parallelFor << "ms (x"
+                                      << reference.parallelFor / timings.parallelFor << "), " << jobCount
+                                      << " jobs " << timings.smallJobs << "ms (x"
+                                      << reference.smallJobs / timings.smallJobs << "), " << waveCount
+                                      << " dependent waves " << timings.dependencies << "ms (x"
+                                      << reference.dependencies / timings.dependencies << ")";
+            LOGGER_ENDL;
+        }
+    } catch (const std::exception &e) {
+        logger->err("JobSystem") << e.what();
+        LOGGER_ENDL;
+        return 1;
+    }
+    return 0;
+}
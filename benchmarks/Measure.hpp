@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <stdexcept>
+#include <string>
+
+// Call the function once to warm the caches, then return the mean duration of a call, in milliseconds
+template <std::invocable Function>
+double measure(unsigned iterations, Function &&function)
+{
+    function();
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++) { function(); }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// The tests exit with an error when an exception escapes main
+#define CHECK(condition)                                                                                        \
+    do {                                                                                                        \
+        if (!(condition))                                                                                       \
+            throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #condition); \
+    } while (0)
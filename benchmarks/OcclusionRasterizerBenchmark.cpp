@@ -0,0 +1,81 @@
+#include <Logger.hpp>
+#include <cstdint>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+#include "Measure.hpp"
+#include "OcclusionRasterizer.hpp"
+
+static constexpr unsigned frameCount = 100;
+static constexpr uint32_t occluderCount = 200;
+static constexpr uint32_t objectCount = 10'000;
+
+// Unit cube, 12 triangles
+static const OcclusionRasterizer::Mesh cube{
+    .positions =
+        {
+            {-0.5f, -0.5f, -0.5f},
+            {0.5f, -0.5f, -0.5f},
+            {0.5f, 0.5f, -0.5f},
+            {-0.5f, 0.5f, -0.5f},
+            {-0.5f, -0.5f, 0.5f},
+            {0.5f, -0.5f, 0.5f},
+            {0.5f, 0.5f, 0.5f},
+            {-0.5f, 0.5f, 0.5f},
+        },
+    .indices = {0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+                3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2},
+};
+
+// City blocks around the camera: the buildings are the occluders, and the objects are scattered between them
+static void benchmark(unsigned nbOfThreads, uint32_t width, uint32_t height)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> buildingSize(5.0f, 15.0f);
+    std::uniform_real_distribution<float> objectSize(0.5f, 2.0f);
+
+    std::vector<glm::mat4> occluders(occluderCount);
+    for (auto &model: occluders) {
+        const glm::vec3 size(buildingSize(rng), buildingSize(rng) * 3.0f, buildingSize(rng));
+        const glm::vec3 center(position(rng), size.y * 0.5f, position(rng));
+        model = glm::scale(glm::translate(glm::mat4(1.0f), center), size);
+    }
+    std::vector<AABB> objects(objectCount);
+    for (auto &box: objects) {
+        const glm::vec3 center(position(rng), objectSize(rng), position(rng));
+        box = {.min = center - glm::vec3(objectSize(rng)), .max = center + glm::vec3(objectSize(rng))};
+    }
+
+    const glm::mat4 projection = glm::perspective(glm::radians(70.0f), float(width) / height, 0.1f, 300.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 2.0f, -1.0f), glm::vec3(0, 1, 0));
+
+    JobSystem jobSystem(nbOfThreads);
+    OcclusionRasterizer rasterizer(jobSystem, width, height);
+    const double rasterizationTime = measure(frameCount, [&] {
+        rasterizer.beginFrame(projection * view);
+        for (const auto &model: occluders) { rasterizer.addOccluder(cube, model); }
+        rasterizer.rasterize();
+    });
+    const double testTime = measure(frameCount, [&] {
+        for (const auto &box: objects) { rasterizer.isVisible(box); }
+    });
+    const auto &stats = rasterizer.getStats();
+
+    logger->info("OcclusionRasterizer") << jobSystem.getNbOfThreads() << " threads, " << rasterizer.getWidth() << "x"
+                                        << rasterizer.getHeight() << ": " << stats.occluderTriangles
+                                        << " triangles rasterized in " << rasterizationTime << "ms, " << objectCount
+                                        << " objects tested in " << testTime << "ms, "
+                                        << stats.occludedObjects / (frameCount + 1) << " occluded";
+    LOGGER_ENDL;
+}
+
+int main()
+{
+    for (const unsigned nbOfThreads: {1u, 0u}) {
+        benchmark(nbOfThreads, OcclusionRasterizer::defaultWidth, OcclusionRasterizer::defaultHeight);
+        benchmark(nbOfThreads, OcclusionRasterizer::defaultWidth * 2, OcclusionRasterizer::defaultHeight * 2);
+    }
+    return 0;
+}
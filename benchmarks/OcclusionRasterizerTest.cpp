@@ -0,0 +1,190 @@
+#include <Logger.hpp>
+#include <cmath>
+#include <exception>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+#include "Measure.hpp"
+#include "OcclusionRasterizer.hpp"
+
+static const glm::mat4 identity(1.0f);
+
+// Quad covering the left half of the screen, with the identity view projection
+static const OcclusionRasterizer::Mesh leftHalf{
+    .positions = {{-1.0f, -1.0f, 0.5f}, {0.0f, -1.0f, 0.5f}, {0.0f, 1.0f, 0.5f}, {-1.0f, 1.0f, 0.5f}},
+    .indices = {0, 1, 2, 0, 2, 3},
+};
+
+static float pixelCenter(uint32_t pixel, uint32_t size) { return (pixel + 0.5f) / size * 2.0f - 1.0f; }
+
+static void testEmptyFrame(JobSystem &jobSystem)
+{
+    OcclusionRasterizer rasterizer(jobSystem, 64, 64);
+    rasterizer.beginFrame(identity);
+    rasterizer.rasterize();
+
+    for (const float depth: rasterizer.getDepthBuffer()) { CHECK(depth == 1.0f); }
+    CHECK(rasterizer.isVisible({.min = {-0.5f, -0.5f, 0.9f}, .max = {0.5f, 0.5f, 0.95f}}));
+}
+
+static void testCoverage(JobSystem &jobSystem)
+{
+    OcclusionRasterizer rasterizer(jobSystem, 64, 64);
+    rasterizer.beginFrame(identity);
+    rasterizer.addOccluder(leftHalf, identity);
+    rasterizer.rasterize();
+    CHECK(rasterizer.getStats().occluderTriangles == 2);
+
+    const auto &depthBuffer = rasterizer.getDepthBuffer();
+    for (uint32_t y = 0; y < 64; y++) {
+        for (uint32_t x = 0; x < 64; x++) {
+            const float expected = (pixelCenter(x, 64) < 0.0f) ? (0.5f) : (1.0f);
+            CHECK(depthBuffer[y * 64 + x] == expected);
+        }
+    }
+
+    // Behind the quad, in front of it, next to it, and outside of the screen
+    CHECK(!rasterizer.isVisible({.min = {-0.9f, -0.5f, 0.6f}, .max = {-0.5f, 0.5f, 0.7f}}));
+    CHECK(rasterizer.isVisible({.min = {-0.9f, -0.5f, 0.3f}, .max = {-0.5f, 0.5f, 0.7f}}));
+    CHECK(rasterizer.isVisible({.min = {0.1f, 0.5f, 0.9f}, .max = {0.2f, 0.6f, 0.95f}}));
+    CHECK(!rasterizer.isVisible({.min = {2.0f, 2.0f, 0.5f}, .max = {3.0f, 3.0f, 0.6f}}));
+    CHECK(rasterizer.getStats().testedObjects == 4);
+    CHECK(rasterizer.getStats().occludedObjects == 2);
+}
+
+static void testDepthInterpolation(JobSystem &jobSystem)
+{
+    // Inside when y <= 2x - 1, with a depth of 0.2 + 0.6x
+    const OcclusionRasterizer::Mesh slope{
+        .positions = {{0.0f, -1.0f, 0.2f}, {1.0f, -1.0f, 0.8f}, {1.0f, 1.0f, 0.8f}},
+        .indices = {0, 2, 1},
+    };
+    OcclusionRasterizer rasterizer(jobSystem, 64, 64);
+    rasterizer.beginFrame(identity);
+    rasterizer.addOccluder(slope, identity);
+    rasterizer.rasterize();
+
+    const auto &depthBuffer = rasterizer.getDepthBuffer();
+    for (uint32_t y = 0; y < 64; y++) {
+        for (uint32_t x = 0; x < 64; x++) {
+            const float px = pixelCenter(x, 64);
+            const float distance = pixelCenter(y, 64) - (2.0f * px - 1.0f);
+            // Skip the pixels on the edge
+            if (std::abs(distance) < 0.1f) continue;
+            const float expected = (distance < 0.0f) ? (0.2f + 0.6f * px) : (1.0f);
+            CHECK(std::abs(depthBuffer[y * 64 + x] - expected) < 1e-4f);
+        }
+    }
+}
+
+static void testWinding(JobSystem &jobSystem)
+{
+    OcclusionRasterizer::Mesh reversed = leftHalf;
+    reversed.indices = {0, 2, 1, 0, 3, 2};
+
+    OcclusionRasterizer rasterizer(jobSystem, 64, 64);
+    rasterizer.beginFrame(identity);
+    rasterizer.addOccluder(leftHalf, identity);
+    rasterizer.rasterize();
+    const auto expected = rasterizer.getDepthBuffer();
+
+    rasterizer.beginFrame(identity);
+    rasterizer.addOccluder(reversed, identity);
+    rasterizer.rasterize();
+    CHECK(rasterizer.getDepthBuffer() == expected);
+}
+
+static void testUnalignedSize(JobSystem &jobSystem)
+{
+    const OcclusionRasterizer::Mesh fullscreen{
+        .positions = {{-1.0f, -1.0f, 0.3f}, {1.0f, -1.0f, 0.3f}, {1.0f, 1.0f, 0.3f}, {-1.0f, 1.0f, 0.3f}},
+        .indices = {0, 1, 2, 0, 2, 3},
+    };
+    // Neither a multiple of the tile size nor of the 4 pixels processed at once
+    OcclusionRasterizer rasterizer(jobSystem, 101, 37);
+    CHECK(rasterizer.getWidth() == 104);
+    CHECK(rasterizer.getHeight() == 37);
+
+    rasterizer.beginFrame(identity);
+    rasterizer.addOccluder(fullscreen, identity);
+    rasterizer.rasterize();
+    for (const float depth: rasterizer.getDepthBuffer()) { CHECK(depth == 0.3f); }
+}
+
+static void testPerspective(JobSystem &jobSystem)
+{
+    const glm::mat4 viewproj = glm::perspective(glm::radians(70.0f), 1.0f, 0.1f, 100.0f) *
+                               glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // Wall 5 units in front of the camera
+    const OcclusionRasterizer::Mesh wall{
+        .positions = {{-20.0f, -20.0f, -5.0f}, {20.0f, -20.0f, -5.0f}, {20.0f, 20.0f, -5.0f}, {-20.0f, 20.0f, -5.0f}},
+        .indices = {0, 1, 2, 0, 2, 3},
+    };
+    // Behind the camera, dropped
+    const OcclusionRasterizer::Mesh behind{
+        .positions = {{-1.0f, -1.0f, 5.0f}, {1.0f, -1.0f, 5.0f}, {0.0f, 1.0f, 5.0f}},
+        .indices = {0, 1, 2},
+    };
+
+    OcclusionRasterizer rasterizer(jobSystem);
+    rasterizer.beginFrame(viewproj);
+    rasterizer.addOccluder(wall, identity);
+    rasterizer.addOccluder(behind, identity);
+    rasterizer.rasterize();
+    CHECK(rasterizer.getStats().occluderTriangles == 2);
+
+    CHECK(!rasterizer.isVisible({.min = {-1.0f, -1.0f, -11.0f}, .max = {1.0f, 1.0f, -9.0f}}));
+    CHECK(rasterizer.isVisible({.min = {-1.0f, -1.0f, -4.0f}, .max = {1.0f, 1.0f, -3.0f}}));
+    // Crossing the near plane
+    CHECK(rasterizer.isVisible({.min = glm::vec3(-1.0f), .max = glm::vec3(1.0f)}));
+
+    // The model matrix moves the wall behind the box
+    const glm::mat4 model = glm::translate(identity, glm::vec3(0.0f, 0.0f, -10.0f));
+    rasterizer.beginFrame(viewproj);
+    rasterizer.addOccluder(wall, model);
+    rasterizer.rasterize();
+    CHECK(rasterizer.isVisible({.min = {-1.0f, -1.0f, -11.0f}, .max = {1.0f, 1.0f, -9.0f}}));
+}
+
+static void testThreadCount()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coordinate(-1.5f, 1.5f);
+    std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+    OcclusionRasterizer::Mesh triangles;
+    for (uint32_t i = 0; i < 300; i++) {
+        triangles.positions.push_back({coordinate(rng), coordinate(rng), depth(rng)});
+        triangles.indices.push_back(i);
+    }
+
+    // Every tile is rasterized by a single thread, in the same order, so the result does not depend on the threads
+    JobSystem serial(1);
+    JobSystem parallel(4);
+    OcclusionRasterizer serialRasterizer(serial);
+    OcclusionRasterizer parallelRasterizer(parallel);
+    for (auto *rasterizer: {&serialRasterizer, &parallelRasterizer}) {
+        rasterizer->beginFrame(identity);
+        rasterizer->addOccluder(triangles, identity);
+        rasterizer->rasterize();
+    }
+    CHECK(serialRasterizer.getDepthBuffer() == parallelRasterizer.getDepthBuffer());
+}
+
+int main()
+{
+    try {
+        JobSystem jobSystem(4);
+        testEmptyFrame(jobSystem);
+        testCoverage(jobSystem);
+        testDepthInterpolation(jobSystem);
+        testWinding(jobSystem);
+        testUnalignedSize(jobSystem);
+        testPerspective(jobSystem);
+        testThreadCount();
+    } catch (const std::exception &e) {
+        logger->err("OcclusionRasterizer") << e.what();
+        LOGGER_ENDL;
+        return 1;
+    }
+    return 0;
+}
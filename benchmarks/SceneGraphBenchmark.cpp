@@ -0,0 +1,59 @@
+#include <Logger.hpp>
+#include <cstdint>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Measure.hpp"
+#include "SceneGraph.hpp"
+
+static constexpr unsigned frameCount = 100;
+// One node out of a hundred moves each frame
+static constexpr uint32_t movingRatio = 100;
+
+// Nodes in chains of the given depth, under a common root. A depth of 1 gives a wide hierarchy.
+static void benchmark(const std::string &name, uint32_t nodeCount, uint32_t chainDepth)
+{
+    const glm::mat4 offset = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+
+    SceneGraph graph;
+    std::vector<SceneGraph::NodeID> nodes(nodeCount);
+    std::vector<uint32_t> parents(nodeCount, SceneGraph::invalidNode);
+    nodes[0] = graph.createNode(offset, SceneGraph::invalidNode, 0);
+    for (uint32_t i = 1; i < nodeCount; i++) {
+        parents[i] = ((i - 1) % chainDepth == 0) ? (0) : (i - 1);
+        nodes[i] = graph.createNode(offset, nodes[parents[i]], i);
+    }
+    graph.update([](uint32_t, const glm::mat4 &) {});
+
+    std::mt19937 rng(nodeCount);
+    // The root stays in place, moving it would update the whole hierarchy
+    std::uniform_int_distribution<uint32_t> node(1, nodeCount - 1);
+    uint64_t updated = 0;
+    const double updateTime = measure(frameCount, [&] {
+        for (uint32_t i = 0; i < nodeCount / movingRatio; i++) { graph.setLocalTransform(nodes[node(rng)], offset); }
+        graph.update([&](uint32_t, const glm::mat4 &) { updated++; });
+    });
+
+    // Baseline: every world matrix recomputed each frame, as without the dirty tracking
+    std::vector<glm::mat4> worldTransforms(nodeCount, offset);
+    const double fullTime = measure(frameCount, [&] {
+        for (uint32_t i = 1; i < nodeCount; i++) { worldTransforms[i] = worldTransforms[parents[i]] * offset; }
+    });
+
+    logger->info("SceneGraph") << name << ", " << nodeCount << " nodes: " << updateTime << "ms/frame, "
+                               << updated / (frameCount + 1) << " nodes updated/frame (full update " << fullTime
+                               << "ms)";
+    LOGGER_ENDL;
+}
+
+int main()
+{
+    for (const uint32_t nodeCount: {10'000u, 100'000u}) {
+        benchmark("wide", nodeCount, 1);
+        benchmark("chains of 8", nodeCount, 8);
+        benchmark("chains of 64", nodeCount, 64);
+    }
+    return 0;
+}
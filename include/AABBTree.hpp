@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "types/AABB.hpp"
+
+// Incrementally updated bounding volume hierarchy. Leaves store a "fat" AABB so small movements do not
+// trigger a reinsertion, new leaves are placed using a surface area heuristic and the tree is kept balanced
+// with rotations.
+class AABBTree
+{
+public:
+    static constexpr int32_t nullNode = -1;
+    static constexpr float aabbMargin = 0.1f;
+    static constexpr float aabbDisplacementMultiplier = 4.0f;
+
+    struct Node {
+        AABB aabb;
+        union {
+            int32_t parent;
+            int32_t next;
+        };
+        int32_t child1 = nullNode;
+        int32_t child2 = nullNode;
+        // leaf = 0, free node = -1
+        int32_t height = -1;
+        uint32_t userData = 0;
+
+        constexpr bool isLeaf() const noexcept { return child1 == nullNode; }
+    };
+
+public:
+    AABBTree();
+    ~AABBTree();
+
+    int32_t createProxy(const AABB &aabb, uint32_t userData);
+    // Bulk insertion: build a balanced subtree from the boxes (userData = firstUserData + index), then insert it.
+    // Much faster than creating the proxies one by one when loading a level.
+    void createProxies(std::span<const AABB> aabbs, uint32_t firstUserData, std::span<int32_t> proxyIds);
+    void destroyProxy(int32_t proxyId);
+    // Returns true if the proxy had to be reinserted in the tree
+    bool moveProxy(int32_t proxyId, const AABB &aabb, const glm::vec3 &displacement);
+    void clear();
+
+    inline uint32_t getUserData(int32_t proxyId) const { return nodes.at(proxyId).userData; }
+    inline void setUserData(int32_t proxyId, uint32_t userData) { nodes.at(proxyId).userData = userData; }
+    inline const AABB &getFatAABB(int32_t proxyId) const { return nodes.at(proxyId).aabb; }
+    constexpr int32_t getHeight() const noexcept { return (root == nullNode) ? (0) : (nodes[root].height); }
+    constexpr uint32_t getNbOfProxy() const noexcept { return proxyCount; }
+    float getAreaRatio() const noexcept;
+
+    // The callback receives the proxy ID, and returns false to stop the query
+    template <std::predicate<int32_t> Callback>
+    void query(const AABB &aabb, Callback &&callback) const;
+    template <std::predicate<int32_t> Callback>
+    void query(const Frustum &frustum, Callback &&callback) const;
+    // The callback receives the proxy ID and the ray, and returns the new maximum distance. Returning 0 stops the
+    // query, returning a negative value ignores the proxy.
+    template <std::invocable<int32_t, const Ray &> Callback>
+    void rayCast(const Ray &ray, Callback &&callback) const;
+
+private:
+    int32_t allocateNode();
+    void freeNode(int32_t nodeId);
+    void insertLeaf(int32_t leaf);
+    void removeLeaf(int32_t leaf);
+    int32_t findBestSibling(const AABB &leafAABB);
+    int32_t buildSubtree(std::span<int32_t> leaves);
+    int32_t balance(int32_t index);
+    void refitAncestors(int32_t index);
+
+private:
+    // Small stack used by the traversals, only spilling on the heap for abnormally deep trees
+    class TraversalStack
+    {
+    public:
+        inline void push(int32_t value)
+        {
+            if (size < inlineStack.size()) {
+                inlineStack[size++] = value;
+            } else {
+                heapStack.push_back(value);
+                size++;
+            }
+        }
+        inline int32_t pop()
+        {
+            size--;
+            if (size < inlineStack.size()) return inlineStack[size];
+            int32_t value = heapStack.back();
+            heapStack.pop_back();
+            return value;
+        }
+        constexpr bool empty() const noexcept { return size == 0; }
+
+    private:
+        std::array<int32_t, 256> inlineStack;
+        std::vector<int32_t> heapStack;
+        size_t size = 0;
+    };
+
+private:
+    int32_t root = nullNode;
+    int32_t freeList = nullNode;
+    uint32_t proxyCount = 0;
+    std::vector<Node> nodes;
+    std::vector<std::pair<int32_t, float>> insertionStack;
+};
+
+template <std::predicate<int32_t> Callback>
+void AABBTree::query(const AABB &aabb, Callback &&callback) const
+{
+    TraversalStack stack;
+    if (root != nullNode) stack.push(root);
+
+    while (!stack.empty()) {
+        const int32_t nodeId = stack.pop();
+        const Node &node = nodes[nodeId];
+        if (!node.aabb.overlaps(aabb)) continue;
+
+        if (node.isLeaf()) {
+            if (!callback(nodeId)) return;
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
+
+template <std::predicate<int32_t> Callback>
+void AABBTree::query(const Frustum &frustum, Callback &&callback) const
+{
+    TraversalStack stack;
+    if (root != nullNode) stack.push(root);
+
+    while (!stack.empty()) {
+        const int32_t nodeId = stack.pop();
+        const Node &node = nodes[nodeId];
+        if (!frustum.intersects(node.aabb)) continue;
+
+        if (node.isLeaf()) {
+            if (!callback(nodeId)) return;
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
+
+template <std::invocable<int32_t, const Ray &> Callback>
+void AABBTree::rayCast(const Ray &ray, Callback &&callback) const
+{
+    Ray currentRay = ray;
+    TraversalStack stack;
+    if (root != nullNode) stack.push(root);
+
+    while (!stack.empty()) {
+        const int32_t nodeId = stack.pop();
+        const Node &node = nodes[nodeId];
+        if (currentRay.intersect(node.aabb) < 0.0f) continue;
+
+        if (node.isLeaf()) {
+            const float distance = callback(nodeId, currentRay);
+            if (distance == 0.0f) return;
+            if (distance > 0.0f) currentRay.maxDistance = distance;
+        } else {
+            stack.push(node.child1);
+            stack.push(node.child2);
+        }
+    }
+}
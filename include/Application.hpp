@@ -1,24 +1,38 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "Benchmark.hpp"
 #include "DeletionQueue.hpp"
+#include "OcclusionRasterizer.hpp"
 #include "Player.hpp"
 #include "VulkanApplication.hpp"
 #include "types/Material.hpp"
 #include "types/Scene.hpp"
+#include "types/StringMap.hpp"
 
 #define WINDOW_TITLE_MAX_SIZE 128
 
 class Application : public VulkanApplication
 {
 public:
-    Application();
+    explicit Application(bool bHeadless = false, const CreationParameters &parameters = {});
     ~Application();
 
-    void run();
+    // Render until the window is closed, or until the frame limit. With a benchmark, the camera follows its path and
+    // the run stops at the end of it.
+    void run(std::optional<uint64_t> frameLimit = std::nullopt, Benchmark *benchmark = nullptr);
     void loadModel();
     void loadTextures();
+    void loadScene(const std::filesystem::path &path);
 
 public:
     double lastX = 400;
@@ -28,13 +42,34 @@ public:
     bool bInteractWithUi = false;
 
 private:
-    void buildIndirectBuffers(Frame &frame);
+    // Every object is uploaded again to the new buffers
+    void onFrameBuffersRecreated() override;
+    // Copy the materials to the buffer of every frame
+    void uploadMaterials();
+    // Run the fixed simulation steps covering the frame time, sampling the input at each step
+    void simulate(float fFrameTime);
+    void buildIndirectBuffers(Frame &frame, const glm::mat4 &viewproj);
+    // Record the draws of a render pass in secondary command buffers, split between the job system threads. The list
+    // is allocated from the frame arena.
+    std::pmr::vector<vk::CommandBuffer> recordDrawCommands(Frame &frame, uint32_t pass,
+                                                           const vk::RenderPassBeginInfo &renderPassInfo,
+                                                           const vk::Buffer &indirectBuffer, bool bWithImgui,
+                                                           std::string_view profilerScope);
+    // The camera interpolated between the last two simulation steps, with the latest orientation
+    Camera::GPUCameraData getGPUCamera() const;
     void drawFrame();
     void drawImgui();
     static void keyboard_callback(GLFWwindow *win, int key, int, int action, int) noexcept;
     static void cursor_callback(GLFWwindow *win, double xpos, double ypos) noexcept;
 
 private:
+    // Objects copied to the GPU buffers by each job
+    static constexpr uint32_t uploadGrainSize = 256;
+    // Below this, splitting the recording costs more than it saves
+    static constexpr uint32_t minBatchesPerRecordingJob = 32;
+    // Past this, a long frame slows the simulation down instead of catching up with ever more steps
+    static constexpr uint32_t maxSimulationSteps = 8;
+
     DeletionQueue applicationDeletionQueue;
     struct {
         struct {
@@ -42,17 +77,48 @@ private:
             float fCloseClippingPlane = 0.1;
             float fFarClippingPlane = MAX_PROJECTION_LIMIT;
             bool bFlyingCam = false;
-            float fGravity = 3.0f;
+            // In units per second squared
+            float fGravity = 180.0f;
         } cameraParamettersOverride;
         char sWindowTitle[WINDOW_TITLE_MAX_SIZE] = "Vulkan";
         bool bShowFpsInTitle = false;
         bool bWireFrameMode = false;
         bool bTmpObject = false;
+        // The index of the temporary object changes when the scene is sorted, its proxy does not
+        int32_t tmpObjectProxy = AABBTree::nullNode;
+        bool bCpuOcclusionCulling = false;
         std::array<float, 4> vClearColor = {0.0f, 0.0f, 0.0f, 1.0f};
     } uiRessources = {};
 
     Player player;
     Scene scene;
+    // Objects modified since each frame object buffer was last written
+    std::array<Scene::DirtyRange, MAX_FRAME_FRAME_IN_FLIGHT> pendingUploads;
     std::vector<gpuObject::Material> materials;
+    gpuObject::CullingStats cullingStats = {};
+    // Last frame completed by the GPU
+    RenderStats renderStats = {};
+    uint64_t frameNumber = 0;
+    // One line per frame while open
+    std::ofstream renderStatsLog;
+    OcclusionRasterizer occlusionRasterizer;
+    StringMap<OcclusionRasterizer::Mesh> occluderMeshes;
     bool firstMouse = true;
+    // Duration of the last frame, in seconds
+    float fElapsedTime = 0;
+    // Time not simulated yet, in seconds, always less than a step after simulate()
+    float fSimulationAccumulator = 0;
+    // Fraction of a step the rendered camera is past the previous step
+    float fSimulationAlpha = 1;
+    uint32_t simulationSteps = 0;
+    // Time the last frame was blocked on the GPU or the swapchain, in seconds
+    float fWaitTime = 0;
+    // Between the last two presentations, or submissions when headless, in seconds
+    float fPresentInterval = 0;
+    std::chrono::steady_clock::time_point lastPresentTime = {};
+    // Last poll of the input used by the camera, and the time from it to the submission of the frame, in seconds
+    std::chrono::steady_clock::time_point inputTime = {};
+    float fInputLatency = 0;
+    // GPU time of the last frame completed by the GPU, in milliseconds
+    std::optional<float> gpuFrameTime;
 };
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <glm/vec3.hpp>
+#include <vector>
+
+// Replays a scripted camera path with a fixed simulated timestep, and reports the distribution of the frame times.
+//
+// Path format, one statement per line ('#' starts a comment):
+//   timestep <seconds>                       simulated time between two frames, 1/60 by default
+//   warmup <frames>                          frames rendered at the start of the path before measuring, 60 by default
+//   key <time> <x> <y> <z> <yaw> <pitch>     camera keyframe, sorted by time
+// The camera is interpolated linearly between the keyframes.
+class Benchmark
+{
+public:
+    struct Keyframe {
+        float fTime;
+        glm::vec3 position;
+        float fYaw;
+        float fPitch;
+    };
+
+    // In milliseconds
+    struct Summary {
+        float fMean = 0.0f;
+        float fMedian = 0.0f;
+        float fPercentile95 = 0.0f;
+        float fPercentile99 = 0.0f;
+        float fMax = 0.0f;
+    };
+
+public:
+    explicit Benchmark(const std::filesystem::path &path);
+    ~Benchmark();
+
+    // Camera of the current frame
+    Keyframe getCamera() const;
+    inline bool isWarmingUp() const noexcept { return frameIndex < warmupFrames; }
+    bool isDone() const noexcept;
+
+    // Record the measures of the current frame, in milliseconds, and move to the next one
+    void endFrame(float fFrameTime, float fCpuTime, float fPresentInterval);
+    // The GPU times are read back a few frames late, so they are recorded on their own
+    void addGPUTime(float fGpuTime);
+
+    void writeReport(const std::filesystem::path &path) const;
+    static Summary summarize(const std::vector<float> &samples);
+
+private:
+    std::filesystem::path pathFile;
+    std::vector<Keyframe> keyframes;
+    float fTimestep = 1.0f / 60.0f;
+    uint32_t warmupFrames = 60;
+
+    uint64_t frameIndex = 0;
+    std::vector<float> frameTimes;
+    std::vector<float> cpuTimes;
+    std::vector<float> gpuTimes;
+    std::vector<float> presentIntervals;
+};
@@ -28,6 +28,8 @@ public:
     GPUCameraData getGPUCameraData(float fFOV = 70.f, float fAspectRatio = 1700.f / 900.f,
                                    float fCloseClippingPlane = 0.1,
                                    float fFarClippingPlane = MAX_PROJECTION_LIMIT) const;
+    // In degrees
+    void setOrientation(float newYaw, float newPitch);
 
 protected:
     void updateCameraVectors();
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vk_mem_alloc.hpp>
+#include <vulkan/vulkan.hpp>
+
+// Vulkan handles, with their VMA allocation if any, destroyed once the GPU timeline reached the value they were last
+// used with. The entries are plain handles stored in a ring buffer, so pushing one does not allocate, unless the
+// queue is full and doubles its capacity.
+//
+// A queue can also hold resources that are still in use, and hand them to another queue when they are retired. Those
+// are pushed with the value 0, and are only destroyed by flush() or handed over by moveTo().
+class DeferredDestructionQueue
+{
+public:
+    static constexpr size_t defaultCapacity = 256;
+
+public:
+    DeferredDestructionQueue();
+    ~DeferredDestructionQueue();
+    DeferredDestructionQueue(const DeferredDestructionQueue &) = delete;
+    DeferredDestructionQueue &operator=(const DeferredDestructionQueue &) = delete;
+
+    void init(vk::Device &device, vma::Allocator &allocator, size_t capacity = defaultCapacity);
+
+    // The values are pushed in increasing order, and the entries are destroyed in the same order, so a view goes
+    // before its image. Buffers and images are destroyed with their allocation.
+    template <typename Handle>
+    void push(uint64_t value, Handle handle, vma::Allocation allocation = {})
+    {
+        if (!handle) return;
+        pushEntry({
+            .value = value,
+            .type = Handle::objectType,
+            .handle = (uint64_t)(static_cast<typename Handle::CType>(handle)),
+            .allocation = allocation,
+        });
+    }
+    // Move every entry to the other queue, tagged with the value. Used to retire a set of resources at once.
+    void moveTo(DeferredDestructionQueue &other, uint64_t value);
+
+    // Destroy the entries whose value the timeline reached
+    void flush(uint64_t completedValue);
+    // Destroy everything, the device must be idle
+    void flush();
+
+    inline size_t size() const noexcept { return count; }
+
+private:
+    struct Entry {
+        uint64_t value;
+        vk::ObjectType type;
+        uint64_t handle;
+        vma::Allocation allocation;
+    };
+
+    void pushEntry(const Entry &entry);
+    void destroy(const Entry &entry);
+    inline Entry &at(size_t index) noexcept { return entries[(first + index) % entries.size()]; }
+
+private:
+    vk::Device device = VK_NULL_HANDLE;
+    vma::Allocator allocator = {};
+    std::vector<Entry> entries;
+    size_t first = 0;
+    size_t count = 0;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Bump allocator for the transient CPU data built by a frame in flight. Everything allocated from it is released at
+// once by reset(), when the GPU is done with the frame. The buffer is kept from one frame to the next, and grows at
+// the reset following an overflow, so a frame in a steady state does not touch the global heap.
+// Not thread safe: only the thread building the frame allocates from it.
+class FrameArena
+{
+public:
+    static constexpr size_t defaultCapacity = 64 * 1024;
+
+public:
+    explicit FrameArena(size_t initialCapacity = defaultCapacity);
+    ~FrameArena();
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // Every allocation of the frame must be dead
+    void reset();
+
+    inline std::pmr::memory_resource *getResource() noexcept { return &*arena; }
+    inline size_t getCapacity() const noexcept { return capacity; }
+    // Bytes taken from the global heap since the last reset, because the buffer was full
+    inline size_t getOverflow() const noexcept { return overflow.allocated; }
+
+private:
+    // Forwards to the global heap, and counts what the buffer could not fit
+    class OverflowResource : public std::pmr::memory_resource
+    {
+    public:
+        size_t allocated = 0;
+
+    private:
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+    };
+
+private:
+    size_t capacity;
+    std::unique_ptr<std::byte[]> buffer;
+    OverflowResource overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "types/SampleHistory.hpp"
+
+// Timestamp queries written around the passes of a frame. Each frame in flight has its own query pool, read back
+// when the frame slot is reused, so the results arrive a few frames late but the CPU never waits for them.
+class GPUProfiler
+{
+public:
+    static constexpr uint32_t maxScopes = 32;
+    static constexpr uint32_t invalidScope = std::numeric_limits<uint32_t>::max();
+    // Number of frames used for the statistics
+    static constexpr size_t historySize = SampleHistory::historySize;
+
+    struct ScopeStats {
+        std::string name;
+        // In milliseconds
+        SampleHistory history;
+    };
+
+    // Both timestamps are written in the same command buffer
+    class Scope
+    {
+    public:
+        Scope(GPUProfiler &profiler, vk::CommandBuffer &cmd, std::string_view name);
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        GPUProfiler &profiler;
+        vk::CommandBuffer &cmd;
+        uint32_t scope;
+    };
+
+public:
+    GPUProfiler();
+    ~GPUProfiler();
+
+    void init(vk::Device &device, vk::PhysicalDevice &physicalDevice, uint32_t queueFamily, uint32_t nbOfFrames);
+    void destroy();
+
+    // Read the results of the previous use of the frame slot, which must be complete, and reset its queries.
+    // Returns the GPU time of that frame, in milliseconds, when it has results.
+    std::optional<float> beginFrame(vk::CommandBuffer &cmd, uint32_t frameIndex);
+    // Thread safe. Returns invalidScope when the profiler is unsupported or full.
+    uint32_t allocateScope(std::string_view name);
+    void writeBegin(vk::CommandBuffer &cmd, uint32_t scope);
+    void writeEnd(vk::CommandBuffer &cmd, uint32_t scope);
+
+    constexpr bool isSupported() const noexcept { return bSupported; }
+    constexpr const std::vector<ScopeStats> &getStats() const noexcept { return stats; }
+    void exportCSV(const std::filesystem::path &path) const;
+    void exportJSON(const std::filesystem::path &path) const;
+
+private:
+    void addSample(const std::string &name, float fMilliseconds);
+
+private:
+    struct FrameQueries {
+        vk::QueryPool pool = VK_NULL_HANDLE;
+        std::vector<std::string> names;
+    };
+
+    vk::Device device = VK_NULL_HANDLE;
+    bool bSupported = false;
+    float fTimestampPeriod = 1.0f;
+    uint64_t timestampMask = ~uint64_t(0);
+
+    std::mutex scopeMutex;
+    uint32_t currentFrame = 0;
+    std::vector<FrameQueries> frames;
+    std::vector<ScopeStats> stats;
+    // Reused by addSample, so the frames do not allocate
+    std::vector<float> sortedSamples;
+};
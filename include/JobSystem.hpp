@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing task scheduler. Each thread owns a Chase-Lev deque: it pushes and pops jobs at the bottom, while
+// idle threads steal from the top of the other deques. The thread that creates the JobSystem is worker 0: it does not
+// run jobs in the background, but executes them while it waits on a counter.
+//
+// The tasks come from a fixed pool owned by the scheduling thread, and the job is stored in the task itself, so
+// scheduling does not allocate. Only the threads outside of the job system, and a thread with every task of its pool
+// in flight, fall back to the heap.
+class JobSystem
+{
+public:
+    class Counter;
+    // Bytes available to the captures of a job
+    static constexpr size_t jobStorageSize = 128;
+
+private:
+    struct Task {
+        alignas(std::max_align_t) std::byte storage[jobStorageSize];
+        void (*run)(void *storage) = nullptr;
+        void (*destroy)(void *storage) = nullptr;
+        Counter *counter = nullptr;
+        // Next task of a continuation list, or of the injection queue
+        Task *next = nullptr;
+        // A pooled task is free again once its job is destroyed, the others are deleted
+        std::atomic<bool> bFree = true;
+        bool bPooled = false;
+    };
+
+public:
+    // Number of unfinished jobs of a group. Jobs can be scheduled to run once a counter reaches zero.
+    // A counter must be waited on before being destroyed.
+    class Counter
+    {
+    public:
+        Counter() = default;
+        Counter(const Counter &) = delete;
+        Counter &operator=(const Counter &) = delete;
+
+        inline bool isDone() const noexcept { return value.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend JobSystem;
+        std::atomic<uint32_t> value = 0;
+        // Guards the decrements, so the last job is done with the counter once the lock is released
+        std::mutex mutex;
+        Task *continuations = nullptr;
+        std::exception_ptr exception;
+    };
+
+public:
+    // 0 threads uses one thread per core, the calling thread included
+    explicit JobSystem(unsigned nbOfThreads = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // The counter, if any, is incremented now and decremented when the job is done
+    template <std::invocable Job>
+    void schedule(Job &&job, Counter *counter = nullptr);
+    // Schedule the job once the dependency reached zero
+    template <std::invocable Job>
+    void scheduleAfter(Counter &dependency, Job &&job, Counter *counter = nullptr);
+    // Run other jobs until the counter reaches zero, and rethrow the first exception thrown by its jobs
+    void wait(Counter &counter);
+
+    // Split [0, count) in chunks of grainSize elements, the function receives the [begin, end) range of a chunk.
+    // Returns once every chunk is done.
+    template <std::invocable<uint32_t, uint32_t> Function>
+    void parallelFor(uint32_t count, uint32_t grainSize, Function &&function);
+
+    inline unsigned getNbOfThreads() const noexcept { return queues.size(); }
+
+private:
+    // Chase-Lev deque, from "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al. 2013)
+    class WorkQueue
+    {
+    public:
+        static constexpr int64_t capacity = 4096;
+
+    public:
+        // Owner only, returns false when the queue is full
+        bool push(Task *task) noexcept;
+        // Owner only
+        Task *pop() noexcept;
+        // Any thread
+        Task *steal() noexcept;
+
+    private:
+        alignas(64) std::atomic<int64_t> top = 0;
+        alignas(64) std::atomic<int64_t> bottom = 0;
+        std::array<std::atomic<Task *>, capacity> tasks = {};
+    };
+
+    // Tasks allocated by their thread only, and released by the thread that ran them
+    class TaskPool
+    {
+    public:
+        static constexpr size_t capacity = 1024;
+
+    public:
+        // Returns nullptr when every task is in flight
+        Task *allocate() noexcept;
+
+    private:
+        std::array<Task, capacity> tasks;
+        size_t cursor = 0;
+    };
+
+private:
+    template <std::invocable Job>
+    Task *createTask(Job &&job, Counter *counter);
+    Task *allocateTask();
+    // Destroy the job, and give the task back
+    void releaseTask(Task *task) noexcept;
+    void push(Task *task);
+    Task *findTask();
+    void execute(Task *task);
+    void finish(Counter &counter);
+    void workerLoop(unsigned index);
+
+private:
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::unique_ptr<TaskPool>> pools;
+    std::vector<std::jthread> workers;
+
+    // Used by the threads that are not part of the job system, and when a queue is full. Linked through Task::next.
+    std::mutex injectionMutex;
+    Task *injectionHead = nullptr;
+    Task *injectionTail = nullptr;
+
+    // Sleeping workers are woken up when a job is pushed
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<uint32_t> pendingJobs = 0;
+    bool bStop = false;
+};
+
+template <std::invocable Job>
+void JobSystem::schedule(Job &&job, Counter *counter)
+{
+    Task *task = createTask(std::forward<Job>(job), counter);
+    if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+    push(task);
+}
+
+template <std::invocable Job>
+void JobSystem::scheduleAfter(Counter &dependency, Job &&job, Counter *counter)
+{
+    Task *task = createTask(std::forward<Job>(job), counter);
+    if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(dependency.mutex);
+        if (dependency.value.load(std::memory_order_acquire) > 0) {
+            task->next = dependency.continuations;
+            dependency.continuations = task;
+            return;
+        }
+    }
+    push(task);
+}
+
+template <std::invocable Job>
+JobSystem::Task *JobSystem::createTask(Job &&job, Counter *counter)
+{
+    using Callable = std::decay_t<Job>;
+    static_assert(sizeof(Callable) <= jobStorageSize, "the job captures do not fit in a task");
+    static_assert(alignof(Callable) <= alignof(std::max_align_t), "the job is over-aligned");
+
+    Task *task = allocateTask();
+    try {
+        new (task->storage) Callable(std::forward<Job>(job));
+    } catch (...) {
+        task->destroy = [](void *) {};
+        releaseTask(task);
+        throw;
+    }
+    task->run = [](void *storage) { (*static_cast<Callable *>(storage))(); };
+    task->destroy = [](void *storage) { std::destroy_at(static_cast<Callable *>(storage)); };
+    task->counter = counter;
+    task->next = nullptr;
+    return task;
+}
+
+template <std::invocable<uint32_t, uint32_t> Function>
+void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, Function &&function)
+{
+    grainSize = std::max(grainSize, 1u);
+    if (count <= grainSize || queues.size() == 1) {
+        if (count > 0) function(0, count);
+        return;
+    }
+
+    Counter counter;
+    for (uint32_t begin = 0; begin < count; begin += grainSize) {
+        const uint32_t end = std::min(begin + grainSize, count);
+        schedule([&function, begin, end] { function(begin, end); }, &counter);
+    }
+    // The calling thread pops its own chunks while the other threads steal them
+    wait(counter);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "types/AABB.hpp"
+
+// Low resolution depth buffer rasterized on the CPU from a small set of occluders, used to cull objects before
+// the indirect commands are written. Rasterization is split in screen tiles, processed by the job system.
+class OcclusionRasterizer
+{
+public:
+    static constexpr uint32_t defaultWidth = 320;
+    static constexpr uint32_t defaultHeight = 192;
+    static constexpr uint32_t tileWidth = 64;
+    static constexpr uint32_t tileHeight = 32;
+
+    struct Mesh {
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+    };
+
+    struct Stats {
+        uint32_t occluderTriangles = 0;
+        uint32_t testedObjects = 0;
+        uint32_t occludedObjects = 0;
+        float fRasterizationTime = 0.0f;
+        float fTestTime = 0.0f;
+    };
+
+public:
+    explicit OcclusionRasterizer(JobSystem &jobSystem, uint32_t width = defaultWidth, uint32_t height = defaultHeight);
+    ~OcclusionRasterizer();
+
+    void resize(uint32_t width, uint32_t height);
+    void beginFrame(const glm::mat4 &viewproj);
+    void addOccluder(const Mesh &mesh, const glm::mat4 &model);
+    void rasterize();
+    // Returns false if the box is hidden behind the occluders
+    bool isVisible(const AABB &box);
+
+    constexpr uint32_t getWidth() const noexcept { return width; }
+    constexpr uint32_t getHeight() const noexcept { return height; }
+    constexpr const std::vector<float> &getDepthBuffer() const noexcept { return depthBuffer; }
+    constexpr const Stats &getStats() const noexcept { return stats; }
+
+private:
+    struct Triangle {
+        // Edge and depth plane equations, in pixels: f(x, y) = a * x + b * y + c
+        glm::vec3 edges[3];
+        glm::vec3 zPlane;
+        int32_t minX, minY, maxX, maxY;
+    };
+
+    void rasterizeTile(uint32_t tileIndex);
+    void rasterizeTriangle(const Triangle &tri, int32_t tileMinX, int32_t tileMinY, int32_t tileMaxX,
+                           int32_t tileMaxY);
+
+private:
+    JobSystem &jobSystem;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tilesX = 0;
+    uint32_t tilesY = 0;
+    glm::mat4 viewproj = glm::mat4(1.0f);
+
+    std::vector<float> depthBuffer;
+    // Reused by every occluder, so a frame in a steady state does not allocate
+    std::vector<glm::vec4> clipPositions;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint32_t>> tileBins;
+    std::chrono::high_resolution_clock::time_point frameStart;
+    Stats stats = {};
+};
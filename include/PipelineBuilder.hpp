@@ -21,4 +21,5 @@ public:
     vk::PipelineMultisampleStateCreateInfo multisampling;
     vk::PipelineLayout pipelineLayout;
     vk::PipelineDepthStencilStateCreateInfo depthStencil;
+    std::vector<vk::DynamicState> dynamicStates;
 };
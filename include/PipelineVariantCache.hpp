@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// Graphics pipeline variants, compiled once on a background thread and kept until the cache is destroyed. The
+// requests never block: switching between compiled variants is a lookup, and the frames in flight can still use the
+// previous one. The compilations have their own thread, rather than the job system, as the main thread runs jobs
+// while it waits for the recording and would then stall on a compilation.
+class PipelineVariantCache
+{
+public:
+    // The pipeline state that is not dynamic. The viewport, the scissor and, when the extended dynamic state is
+    // supported, the cull mode are set when recording.
+    struct Key {
+        vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+        vk::CullModeFlagBits cullMode = vk::CullModeFlagBits::eNone;
+        vk::SampleCountFlagBits msaaSample = vk::SampleCountFlagBits::e1;
+        vk::Format colorFormat = vk::Format::eUndefined;
+
+        bool operator==(const Key &) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const noexcept;
+    };
+    // Called on the compile thread
+    using Builder = std::function<vk::Pipeline(const Key &)>;
+    // Ready once the variant is compiled. Holds the exception if the compilation failed.
+    using Handle = std::shared_future<vk::Pipeline>;
+
+public:
+    PipelineVariantCache();
+    ~PipelineVariantCache();
+
+    // Start the compile thread
+    void init(vk::Device &device, Builder &&builder);
+    // Drop the queued compilations, stop the compile thread and destroy every variant
+    void destroy();
+    // Block until the queued compilations are done, as they use the render pass
+    void wait();
+
+    // Thread safe. Queue the compilation of a variant seen for the first time.
+    Handle request(const Key &key);
+    // The variant if it is compiled, null while it is compiling. Rethrows a failed compilation.
+    vk::Pipeline tryGet(const Key &key);
+    void precompile(const std::vector<Key> &keys);
+    // Compiled, and queued or compiling
+    size_t size();
+    size_t pending();
+
+private:
+    void compileLoop();
+
+private:
+    struct Variant {
+        std::promise<vk::Pipeline> promise;
+        Handle handle;
+    };
+
+    vk::Device device = VK_NULL_HANDLE;
+    Builder builder;
+    std::thread thread;
+
+    std::mutex mutex;
+    // Wakes the compile thread
+    std::condition_variable queueCondition;
+    // Wakes wait()
+    std::condition_variable idleCondition;
+    std::deque<Key> queue;
+    bool bCompiling = false;
+    bool bStop = false;
+    std::unordered_map<Key, Variant, KeyHash> variants;
+};
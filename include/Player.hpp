@@ -6,6 +6,7 @@
 class Player : public Camera
 {
 public:
+    // In units per second
     static constexpr const float SPEED = 25.0f;
     static constexpr const float JUMP = 50.0f;
 
@@ -15,13 +16,18 @@ public:
     Player();
     ~Player();
 
-    void update(float fElapsedTime, float fGravity) noexcept;
+    // Advance the simulation by one fixed step of fTimestep seconds, the gravity being in units per second squared
+    void update(float fTimestep, float fGravity) noexcept;
+    // The camera between the last two steps, fAlpha being the fraction of a step elapsed since the last one
+    Camera getInterpolatedCamera(float fAlpha) const noexcept;
     void processKeyboard(const Movement direction) noexcept;
     void processMouseMovement(float xoffset, float yoffset, bool bConstrainPitch = true) noexcept;
 
 public:
     bool isFreeFly = false;
     glm::vec3 vVelocity = {0, 0, 0};
+    // Before the last step
+    glm::vec3 previousPosition = {0, 0, 0};
     bool bOnFloor = true;
     float movementSpeed = SPEED;
     float jumpHeight = JUMP;
@@ -0,0 +1,105 @@
+#pragma once
+
+// Scoped CPU profiling zones, enabled with the CPU_PROFILING CMake option. When disabled, the macros expand to
+// nothing.
+//
+// PROFILE_SCOPE("name") times the enclosing scope, PROFILE_FUNCTION uses the function name, and
+// PROFILE_EVENT(name, beginTime, endTime) records a span between two std::chrono::steady_clock time points, for
+// the spans that are not a scope. PROFILE_DUMP(path) writes everything recorded so far as Chrome trace events
+// (chrome://tracing or Perfetto).
+// Names must outlive the profiler: use string literals.
+
+#ifdef CPU_PROFILING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Profiler
+{
+public:
+    struct Event {
+        const char *name;
+        // Nanoseconds, from a steady clock
+        int64_t begin;
+        int64_t end;
+    };
+
+    class Zone
+    {
+    public:
+        explicit Zone(const char *name) noexcept;
+        ~Zone();
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+    private:
+        const char *name;
+        int64_t begin;
+    };
+
+public:
+    static Profiler &get();
+    static int64_t now() noexcept;
+
+    // Append to the buffer of the calling thread, without locking
+    void record(const Event &event);
+    // Can be called while other threads are recording
+    void dump(const std::filesystem::path &path);
+
+private:
+    Profiler();
+    ~Profiler();
+
+    // Events are appended to a list of fixed size chunks, so the ones already recorded never move and can be read
+    // while the owner thread keeps writing
+    struct Chunk {
+        static constexpr size_t capacity = 8192;
+
+        ~Chunk() { delete next.load(std::memory_order_relaxed); }
+
+        std::array<Event, capacity> events;
+        std::atomic<size_t> size = 0;
+        std::atomic<Chunk *> next = nullptr;
+    };
+
+    struct ThreadBuffer {
+        uint32_t threadID;
+        std::unique_ptr<Chunk> first;
+        // Only used by the owner thread
+        Chunk *last;
+    };
+
+    ThreadBuffer &getThreadBuffer();
+
+private:
+    int64_t start;
+    std::mutex threadMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) const Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION PROFILE_SCOPE(__func__)
+#define PROFILE_EVENT(name, beginTime, endTime)                                                                    \
+    Profiler::get().record({                                                                                       \
+        .name = (name),                                                                                            \
+        .begin = std::chrono::duration_cast<std::chrono::nanoseconds>((beginTime).time_since_epoch()).count(),     \
+        .end = std::chrono::duration_cast<std::chrono::nanoseconds>((endTime).time_since_epoch()).count(),         \
+    })
+#define PROFILE_DUMP(path) Profiler::get().dump(path)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION
+#define PROFILE_EVENT(name, beginTime, endTime)
+#define PROFILE_DUMP(path)
+
+#endif
@@ -11,6 +11,7 @@ struct QueueFamilyIndices {
     std::optional<uint32_t> presentFamily;
 
     constexpr bool isComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
+    // Without a surface nothing is presented, and the present family is the graphics one
     static QueueFamilyIndices findQueueFamilies(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface)
     {
         QueueFamilyIndices indices;
@@ -18,7 +19,11 @@ struct QueueFamilyIndices {
 
         for (uint32_t i = 0; i < family_property_list.size() && !indices.isComplete(); ++i) {
             if (family_property_list.at(i).queueFlags & vk::QueueFlagBits::eGraphics) indices.graphicsFamily = i;
-            if (device.getSurfaceSupportKHR(i, surface)) indices.presentFamily = i;
+            if (!surface) {
+                indices.presentFamily = indices.graphicsFamily;
+            } else if (device.getSurfaceSupportKHR(i, surface)) {
+                indices.presentFamily = i;
+            }
         }
         return indices;
     }
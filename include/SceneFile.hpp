@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types/vk_types.hpp"
+
+// Binary scene, memory mapped and read in place.
+//
+// Layout: Header, then the name table (meshes followed by textures, fixed size entries), then the objects, stored
+// exactly as the GPU object buffer expects them, then the per object informations.
+class SceneFile
+{
+public:
+    static constexpr uint32_t magic = 0x4e435344;    // "DSCN"
+    static constexpr uint32_t version = 1;
+    static constexpr size_t nameSize = 64;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t objectSize;
+        uint32_t meshCount;
+        uint32_t textureCount;
+        uint32_t objectCount;
+        uint64_t namesOffset;
+        uint64_t objectsOffset;
+        uint64_t infosOffset;
+    };
+
+    struct Name {
+        char str[nameSize];
+    };
+
+    enum ObjectFlags : uint32_t {
+        Occluder = 1 << 0,
+    };
+
+    struct ObjectInfo {
+        uint32_t meshIndex;
+        uint32_t flags;
+    };
+
+public:
+    explicit SceneFile(const std::filesystem::path &path);
+    ~SceneFile();
+    SceneFile(const SceneFile &) = delete;
+    SceneFile &operator=(const SceneFile &) = delete;
+
+    inline const Header &getHeader() const noexcept { return *reinterpret_cast<const Header *>(data); }
+    std::string_view getMeshName(uint32_t index) const;
+    std::string_view getTextureName(uint32_t index) const;
+    std::span<const gpuObject::UniformBufferObject> getObjects() const noexcept;
+    std::span<const ObjectInfo> getObjectInfos() const noexcept;
+
+    // The texture index of each object refers to the texture name table
+    static void write(const std::filesystem::path &path, const std::vector<std::string> &meshNames,
+                      const std::vector<std::string> &textureNames,
+                      std::span<const gpuObject::UniformBufferObject> objects, std::span<const ObjectInfo> infos);
+
+    // Text format, one statement per line ('#' starts a comment):
+    //   object <mesh> <texture> <tx> <ty> <tz> <rx> <ry> <rz> <sx> <sy> <sz> [occluder]
+    // Rotations are in degrees
+    static void convert(const std::filesystem::path &textPath, const std::filesystem::path &binaryPath);
+
+private:
+    void validate() const;
+    std::string_view getName(uint32_t index) const;
+
+private:
+    const std::byte *data = nullptr;
+    size_t size = 0;
+    // Used when memory mapping is not available
+    std::vector<std::byte> fallbackBuffer;
+};
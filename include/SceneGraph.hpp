@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Parent/child transform hierarchy. Nodes are stored in depth order (a parent always comes before its children, new
+// nodes are appended and the storage is sorted again when a node changes parent), so the world matrices of the dirty
+// subtrees are recomputed in a single linear pass, starting at the first dirty node.
+// Node IDs stay valid when the storage is reordered.
+class SceneGraph
+{
+public:
+    using NodeID = uint32_t;
+    static constexpr NodeID invalidNode = std::numeric_limits<NodeID>::max();
+    // Nodes without user data are only used as pivots, and are not reported by update()
+    static constexpr uint32_t noUserData = std::numeric_limits<uint32_t>::max();
+
+public:
+    SceneGraph();
+    ~SceneGraph();
+
+    NodeID createNode(const glm::mat4 &localTransform, NodeID parent = invalidNode,
+                      uint32_t userData = noUserData);
+    // Also destroys the children of the node
+    void destroyNode(NodeID node);
+    // The callback receives the user data of every node destroyed, so their owners can forget the recycled IDs
+    template <std::invocable<uint32_t> Callback>
+    void destroyNode(NodeID node, Callback &&callback);
+    void setParent(NodeID node, NodeID parent);
+    void setLocalTransform(NodeID node, const glm::mat4 &localTransform);
+    void clear();
+
+    inline NodeID getParent(NodeID node) const
+    {
+        const uint32_t parent = parentIndices[getIndex(node)];
+        return (parent == invalidNode) ? (invalidNode) : (nodeIDs[parent]);
+    }
+    inline const glm::mat4 &getLocalTransform(NodeID node) const { return localTransforms[getIndex(node)]; }
+    // Up to date after update()
+    inline const glm::mat4 &getWorldTransform(NodeID node) const { return worldTransforms[getIndex(node)]; }
+    inline uint32_t getUserData(NodeID node) const { return userData[getIndex(node)]; }
+    inline void setUserData(NodeID node, uint32_t data) { userData[getIndex(node)] = data; }
+    inline bool isValid(NodeID node) const noexcept { return node < indices.size() && indices[node] != invalidNode; }
+    inline size_t getNbOfNode() const noexcept { return nodeIDs.size(); }
+
+    // Recompute the world matrices of the dirty subtrees. The callback receives the user data and the new world
+    // matrix of every node that changed.
+    template <std::invocable<uint32_t, const glm::mat4 &> Callback>
+    void update(Callback &&callback);
+
+private:
+    uint32_t getIndex(NodeID node) const;
+    void markDirty(uint32_t index);
+    void sortNodes();
+    // Rebuild the storage with the given nodes, in the given order
+    void applyOrder(const std::vector<uint32_t> &order);
+
+private:
+    // Indexed by node ID
+    std::vector<uint32_t> indices;
+    std::vector<NodeID> freeIDs;
+
+    // Indexed by storage position, in depth order
+    std::vector<NodeID> nodeIDs;
+    std::vector<uint32_t> parentIndices;
+    std::vector<uint32_t> depths;
+    std::vector<glm::mat4> localTransforms;
+    std::vector<glm::mat4> worldTransforms;
+    std::vector<uint32_t> userData;
+    std::vector<uint8_t> dirty;
+
+    uint32_t firstDirty = invalidNode;
+    bool bNeedSort = false;
+};
+
+template <std::invocable<uint32_t, const glm::mat4 &> Callback>
+void SceneGraph::update(Callback &&callback)
+{
+    if (bNeedSort) sortNodes();
+    if (firstDirty == invalidNode) return;
+
+    // The parents are processed before their children, so a dirty flag is propagated down in the same pass
+    for (uint32_t i = firstDirty; i < nodeIDs.size(); i++) {
+        const uint32_t parent = parentIndices[i];
+        if (parent != invalidNode && dirty[parent]) dirty[i] = true;
+        if (!dirty[i]) continue;
+
+        worldTransforms[i] =
+            (parent == invalidNode) ? (localTransforms[i]) : (worldTransforms[parent] * localTransforms[i]);
+        if (userData[i] != noUserData) callback(userData[i], worldTransforms[i]);
+    }
+    std::fill(dirty.begin() + firstDirty, dirty.end(), false);
+    firstDirty = invalidNode;
+}
+
+template <std::invocable<uint32_t> Callback>
+void SceneGraph::destroyNode(NodeID node, Callback &&callback)
+{
+    if (bNeedSort) sortNodes();
+    const uint32_t root = getIndex(node);
+
+    // The descendants are stored after the node: a node is removed if its parent is
+    std::vector<uint8_t> removed(nodeIDs.size(), false);
+    std::vector<uint32_t> order;
+    order.reserve(nodeIDs.size());
+    for (uint32_t i = 0; i < nodeIDs.size(); i++) {
+        const uint32_t parent = parentIndices[i];
+        removed[i] = (i == root) || (i > root && parent != invalidNode && removed[parent]);
+        if (removed[i]) {
+            indices[nodeIDs[i]] = invalidNode;
+            freeIDs.push_back(nodeIDs[i]);
+            if (userData[i] != noUserData) callback(userData[i]);
+        } else {
+            order.push_back(i);
+        }
+    }
+    applyOrder(order);
+}
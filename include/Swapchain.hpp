@@ -2,8 +2,10 @@
 
 #include <stdint.h>
 #include <vector>
+#include <vk_mem_alloc.hpp>
 #include <vulkan/vulkan.hpp>
 
+#include "DeferredDestructionQueue.hpp"
 #include "DeletionQueue.hpp"
 #include "Window.hpp"
 #include "types/CreationParameters.hpp"
@@ -17,7 +19,8 @@ public:
         std::vector<vk::PresentModeKHR> presentModes;
 
         vk::SurfaceFormatKHR chooseSwapSurfaceFormat() noexcept;
-        vk::PresentModeKHR chooseSwapPresentMode() noexcept;
+        vk::PresentModeKHR chooseSwapPresentMode(vk::PresentModeKHR preferredMode) noexcept;
+        uint32_t chooseImageCount(uint32_t requestedCount) noexcept;
         vk::Extent2D chooseSwapExtent(Window &window) noexcept;
         static SupportDetails querySwapChainSupport(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface);
     };
@@ -26,12 +29,28 @@ public:
     Swapchain();
     ~Swapchain();
 
-    void init(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface);
+    void init(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+              const CreationParameters &parameters);
+    // Render to plain images instead, which are neither acquired nor presented
+    void initOffscreen(vk::Extent2D extent, uint32_t nbOfImages, vk::Device &device, vma::Allocator &allocator);
     void destroy();
-    void recreate(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface);
+    void recreate(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+                  const CreationParameters &parameters);
+    // Replace the swapchain with a new one created from it, so the presentation continues. The previous swapchain and
+    // its views are handed to the queue, tagged with the timeline value of their last use.
+    void resize(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+                const CreationParameters &parameters, DeferredDestructionQueue &retired, uint64_t lastUse);
     uint32_t nbOfImage() const;
 
     constexpr const vk::SwapchainKHR &getSwapchain() const noexcept { return swapChain; }
+    constexpr bool isOffscreen() const noexcept { return bOffscreen; }
+    // The mode in use, which can differ from the requested one
+    constexpr vk::PresentModeKHR getPresentMode() const noexcept { return presentMode; }
+    // Layout of the images at the end of a frame
+    constexpr vk::ImageLayout getImageLayout() const noexcept
+    {
+        return (bOffscreen) ? (vk::ImageLayout::eTransferSrcOptimal) : (vk::ImageLayout::ePresentSrcKHR);
+    }
     constexpr float getAspectRatio() const noexcept
     {
         return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
@@ -49,10 +68,11 @@ public:
         };
     }
 
-    inline operator bool() const noexcept { return swapChain; }
+    inline operator bool() const noexcept { return swapChain || bOffscreen; }
 
 private:
-    void createSwapchain(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface);
+    void createSwapchain(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+                         const CreationParameters &parameters, vk::SwapchainKHR oldSwapchain = VK_NULL_HANDLE);
     void getImages(vk::Device &device);
     void createImageViews(vk::Device &device);
 
@@ -60,8 +80,12 @@ private:
     DeletionQueue chainDeletionQueue;
     vk::Extent2D swapChainExtent;
     vk::Format swapChainImageFormat;
+    vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
 
     vk::SwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<vk::Image> swapChainImages;
     std::vector<vk::ImageView> swapChainImageViews;
+
+    bool bOffscreen = false;
+    std::vector<vma::Allocation> offscreenMemory;
 };
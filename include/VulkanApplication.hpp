@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 #include <functional>
+#include <glm/glm.hpp>
 #include <stdint.h>
 #include <string>
 #include <unordered_map>
@@ -9,7 +11,11 @@
 #include <vk_mem_alloc.hpp>
 #include <vulkan/vulkan.hpp>
 
+#include "DeferredDestructionQueue.hpp"
 #include "DeletionQueue.hpp"
+#include "GPUProfiler.hpp"
+#include "JobSystem.hpp"
+#include "PipelineVariantCache.hpp"
 #include "Swapchain.hpp"
 #include "VulkanLoader.hpp"
 #include "Window.hpp"
@@ -17,6 +23,8 @@
 #include "types/CreationParameters.hpp"
 #include "types/Frame.hpp"
 #include "types/Mesh.hpp"
+#include "types/RenderStats.hpp"
+#include "types/StringMap.hpp"
 #include "vk_utils.hpp"
 
 const std::vector<const char *> validationLayers = {
@@ -27,6 +35,11 @@ const std::vector<const char *> deviceExtensions = {
 };
 
 constexpr uint8_t MAX_FRAME_FRAME_IN_FLIGHT = 3;
+// Render passes recorded with secondary command buffers in a frame
+constexpr uint32_t MAX_RENDER_PASS_PER_FRAME = 2;
+
+#define MAX_COMMANDS 100
+#define MAX_MATERIALS 100
 
 class VulkanApplication : protected VulkanLoader
 {
@@ -38,11 +51,14 @@ public:
 #endif
 
 public:
-    VulkanApplication();
+    // A headless application renders offscreen, without a window nor a surface
+    explicit VulkanApplication(bool bHeadless = false, const CreationParameters &parameters = {});
     ~VulkanApplication();
 
     void init(std::function<bool()> &&loadingStage);
     void recreateSwapchain();
+    // Only rebuild the resources depending on the extent, without waiting for the device to be idle
+    void resizeSwapchain();
     AllocatedBuffer createBuffer(uint32_t allocSize, vk::BufferUsageFlags usage, vma::MemoryUsage memoryUsage);
 
 protected:
@@ -53,6 +69,18 @@ protected:
 
     GPUMesh uploadMesh(const CPUMesh &mesh);
     void immediateCommand(std::function<void(vk::CommandBuffer &)> &&);
+    // Block until the graphics queue timeline reached the value
+    void waitTimeline(uint64_t value);
+    inline uint64_t getCompletedTimelineValue() const
+    {
+        return device.getSemaphoreCounterValue(graphicsTimeline.semaphore);
+    }
+    // Destroy the handle once the GPU is done with everything submitted so far
+    template <typename Handle>
+    inline void deferDeletion(Handle handle, vma::Allocation allocation = {})
+    {
+        deferredDeletionQueue.push(graphicsTimeline.value, handle, allocation);
+    }
     void copyBufferToImage(const vk::Buffer &srcBuffer, vk::Image &dstBuffer, uint32_t width, uint32_t height);
     void copyBufferToBuffer(const vk::Buffer &srcBuffer, vk::Buffer &dstBuffer, const vk::DeviceSize &size);
 
@@ -61,6 +89,21 @@ protected:
     void generateMipmaps(vk::Image &image, vk::Format imageFormat, uint32_t texWidth, uint32_t texHeight,
                          uint32_t mipLevel);
 
+    enum class CullingPhase : uint32_t {
+        Early = 0,
+        Late = 1,
+    };
+    void recordOcclusionCulling(vk::CommandBuffer &cmd, Frame &frame, const glm::mat4 &viewproj, CullingPhase phase,
+                                uint32_t objectCount);
+    void recordDepthPyramid(vk::CommandBuffer &cmd, RenderStats &stats);
+    // Variant of the graphics pipeline matching the creation parameters
+    PipelineVariantCache::Key getPipelineKey() const noexcept;
+    // Switch to the variant matching the creation parameters once it is compiled. Until then, keep the previous
+    // variant if it is compatible with the render pass, or set none and the draws are skipped.
+    void updateGraphicsPipeline();
+    // Called once recreateSwapchain() created the per-frame buffers again, their previous content is lost
+    virtual void onFrameBuffersRecreated() {}
+
 private:
     static bool checkValiationLayerSupport();
     static uint32_t debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -70,9 +113,12 @@ private:
     static vk::SampleCountFlagBits getMexUsableSampleCount(vk::PhysicalDevice &physical_device);
     static bool isDeviceSuitable(const vk::PhysicalDevice &gpu, const vk::SurfaceKHR &surface);
     static uint32_t rateDeviceSuitability(const vk::PhysicalDevice &device);
-    static bool checkDeviceExtensionSupport(const vk::PhysicalDevice &device);
+    static std::vector<const char *> getDeviceExtensions(bool bPresent);
+    static bool checkDeviceExtensionSupport(const vk::PhysicalDevice &device, bool bPresent);
 
 private:
+    // Block while the window is minimized
+    void waitForValidExtent();
     void initInstance();
     void initDebug();
     void pickPhysicalDevice();
@@ -82,11 +128,22 @@ private:
     void createRenderPass();
 
     void createPipelineCache();
+    // Empty when there is no cache on disk, or when it was written by another device or driver
+    std::vector<std::byte> loadPipelineCache();
+    void savePipelineCache();
+    // Zone names of the pipeline compilations, so the startup trace tells the warm and cold caches apart
+    inline const char *getPipelineZoneName() const noexcept
+    {
+        return (bPipelineCacheWarm) ? ("Compile pipeline (warm cache)") : ("Compile pipeline (cold cache)");
+    }
     void createPipelineLayout();
-    void createGraphicsPipeline();
+    void createPipelineVariants();
+    vk::Pipeline buildGraphicsPipeline(const PipelineVariantCache::Key &key);
     void createFramebuffers();
     void createCommandPool();
     void createCommandBuffers();
+    void createGPUProfiler();
+    void createStatisticsQueries();
     void createSyncObjects();
     void createDescriptorSetLayout();
     void createTextureDescriptorSetLayout();
@@ -99,16 +156,42 @@ private:
     void createDepthResources();
     void createColorResources();
     void createImgui();
+    // ImGui cycles its vertex buffers over this count, there can be more frames in flight than images
+    inline uint32_t getImguiImageCount() const
+    {
+        return std::max<uint32_t>(swapchain.nbOfImage(), MAX_FRAME_FRAME_IN_FLIGHT);
+    }
+
+    void createOcclusionCullingLayouts();
+    void createOcclusionCullingPipelines();
+    void createDepthPyramid();
+    void createOcclusionCullingDescriptors();
 
 public:
     bool framebufferResized = false;
 
 protected:
     CreationParameters creationParameters = {};
+    JobSystem jobSystem;
+    GPUProfiler gpuProfiler;
     Window window;
     vk::DebugUtilsMessengerEXT debugUtilsMessenger = VK_NULL_HANDLE;
     vk::PhysicalDevice physical_device = VK_NULL_HANDLE;
     vk::SampleCountFlagBits maxMsaaSample = vk::SampleCountFlagBits::e1;
+    bool bMultiDrawIndirectSupported = false;
+    uint32_t maxDrawIndirectCount = 1;
+    bool bPipelineStatisticsSupported = false;
+    // The cull mode is then set when recording, instead of being part of the pipeline variant
+    bool bExtendedDynamicStateSupported = false;
+    // In the order of RenderStats::pipeline, as the results are sorted by bit
+    static constexpr vk::QueryPipelineStatisticFlags pipelineStatistics =
+        vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+        vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+        vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+    // Descriptors written since the last frame
+    uint32_t descriptorWriteCount = 0;
     vma::Allocator allocator;
 
     //  Queues
@@ -123,24 +206,35 @@ protected:
 
     // Pipeline
     vk::RenderPass renderPass = VK_NULL_HANDLE;
+    // Same as renderPass, but keep the previous content of the attachments
+    vk::RenderPass renderPassLoad = VK_NULL_HANDLE;
     vk::DescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
     vk::PipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    // Owned by the variant cache. Null while no compatible variant is compiled.
     vk::Pipeline graphicsPipeline = VK_NULL_HANDLE;
+    PipelineVariantCache::Key graphicsPipelineKey = {};
+    PipelineVariantCache pipelineVariants;
+    // Loaded at startup, and written back on exit
+    static constexpr const char *pipelineCachePath = "pipeline_cache.bin";
     vk::PipelineCache pipelineCache = VK_NULL_HANDLE;
+    bool bPipelineCacheWarm = false;
 
     // Framebuffer
     std::vector<vk::Framebuffer> swapChainFramebuffers;
 
-    // Command Pool
-    vk::CommandPool commandPool = VK_NULL_HANDLE;
-    std::vector<vk::CommandBuffer> commandBuffers;
-
     // Instant commandbuffers
     struct {
-        vk::Fence uploadFence = VK_NULL_HANDLE;
         vk::CommandPool commandPool = VK_NULL_HANDLE;
     } uploadContext = {};
 
+    // Every submission to the graphics queue (frames and uploads) signals the next value of its timeline
+    struct {
+        vk::Semaphore semaphore = VK_NULL_HANDLE;
+        // Last value submitted
+        uint64_t value = 0;
+    } graphicsTimeline = {};
+    DeferredDestructionQueue deferredDeletionQueue;
+
     // Sync
     uint8_t currentFrame = 0;
     Frame frames[MAX_FRAME_FRAME_IN_FLIGHT];
@@ -148,7 +242,7 @@ protected:
     // Models
     AllocatedBuffer vertexBuffers;
     AllocatedBuffer indicesBuffers;
-    std::unordered_map<std::string, GPUMesh> loadedMeshes;
+    StringMap<GPUMesh> loadedMeshes;
 
     vk::DescriptorPool descriptorPool = VK_NULL_HANDLE;
 
@@ -160,12 +254,37 @@ protected:
     vk::DescriptorSet texturesSet = VK_NULL_HANDLE;
 
     // Depthbuffer
+    vk::Format depthFormat = vk::Format::eUndefined;
     AllocatedImage depthResources = {};
     AllocatedImage colorImage = {};
 
+    // Occlusion culling
+    struct {
+        AllocatedImage depthPyramid = {};
+        std::vector<vk::ImageView> pyramidMips;
+        vk::Extent2D pyramidExtent = {};
+        uint32_t pyramidLevels = 0;
+        vk::Sampler pyramidSampler = VK_NULL_HANDLE;
+        AllocatedBuffer visibilityBuffer = {};
+
+        vk::DescriptorPool descriptorPool = VK_NULL_HANDLE;
+        vk::DescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+        vk::DescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+        std::vector<vk::DescriptorSet> reduceSets;
+
+        vk::PipelineLayout reduceLayout = VK_NULL_HANDLE;
+        vk::PipelineLayout cullLayout = VK_NULL_HANDLE;
+        vk::Pipeline reducePipeline = VK_NULL_HANDLE;
+        vk::Pipeline resolvePipeline = VK_NULL_HANDLE;
+        vk::Pipeline cullPipeline = VK_NULL_HANDLE;
+    } occlusion = {};
+
 private:
     DeletionQueue mainDeletionQueue;
     DeletionQueue swapchainDeletionQueue;
+    // Attachments, framebuffers and depth pyramid, which depend on the extent. Destroyed with the swapchain, or moved
+    // to the deferred queue when a resize retires them.
+    DeferredDestructionQueue extentResources;
 };
 
 #ifndef VULKAN_APPLICATION_IMPLEMENTATION
@@ -4,18 +4,23 @@
 #include <string>
 #include <vulkan/vulkan.hpp>
 
+// A headless window creates nothing: its inputs are never triggered and it never closes
 class Window
 {
 public:
-    Window(std::string, unsigned, unsigned);
+    Window(std::string, unsigned, unsigned, bool bHeadless = false);
     Window(Window &) = delete;
     Window(const Window &) = delete;
     ~Window();
     constexpr GLFWwindow *getWindow() noexcept { return window; }
-    inline bool shouldClose() const noexcept { return glfwWindowShouldClose(window); }
-    inline void pollEvent() noexcept { glfwPollEvents(); }
+    constexpr bool isHeadless() const noexcept { return window == nullptr; }
+    inline bool shouldClose() const noexcept { return window && glfwWindowShouldClose(window); }
+    inline void pollEvent() noexcept
+    {
+        if (window) glfwPollEvents();
+    }
     vk::SurfaceKHR createSurface(const vk::Instance &);
-    inline bool isKeyPressed(unsigned key) const { return glfwGetKey(this->window, key) == GLFW_PRESS; }
+    inline bool isKeyPressed(unsigned key) const { return window && glfwGetKey(this->window, key) == GLFW_PRESS; }
 
     void setKeyCallback(GLFWkeyfun &&f) noexcept;
     void setCursorPosCallback(GLFWcursorposfun &&f) noexcept;
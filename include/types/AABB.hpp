@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <limits>
+
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    inline glm::vec3 getCenter() const noexcept { return (min + max) * 0.5f; }
+    inline glm::vec3 getExtent() const noexcept { return (max - min) * 0.5f; }
+    inline bool isValid() const noexcept { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+    // Surface area, used as the SAH cost metric by the AABBTree
+    inline float getArea() const noexcept
+    {
+        const glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    inline bool contains(const AABB &other) const noexcept
+    {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z && other.max.x <= max.x &&
+               other.max.y <= max.y && other.max.z <= max.z;
+    }
+
+    inline bool overlaps(const AABB &other) const noexcept
+    {
+        return min.x <= other.max.x && min.y <= other.max.y && min.z <= other.max.z && other.min.x <= max.x &&
+               other.min.y <= max.y && other.min.z <= max.z;
+    }
+
+    inline void extend(const glm::vec3 &point) noexcept
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    static inline AABB combine(const AABB &a, const AABB &b) noexcept
+    {
+        return {
+            .min = glm::min(a.min, b.min),
+            .max = glm::max(a.max, b.max),
+        };
+    }
+
+    // Bounds of this box once transformed by `model` (Arvo's method)
+    AABB transform(const glm::mat4 &model) const noexcept
+    {
+        AABB result{
+            .min = glm::vec3(model[3]),
+            .max = glm::vec3(model[3]),
+        };
+        for (unsigned col = 0; col < 3; col++) {
+            for (unsigned row = 0; row < 3; row++) {
+                const float a = model[col][row] * min[col];
+                const float b = model[col][row] * max[col];
+                result.min[row] += std::min(a, b);
+                result.max[row] += std::max(a, b);
+            }
+        }
+        return result;
+    }
+};
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float maxDistance = std::numeric_limits<float>::max();
+
+    // Slab test, returns the entry distance or a negative value on miss
+    float intersect(const AABB &box) const noexcept
+    {
+        const glm::vec3 invDir = 1.0f / direction;
+        const glm::vec3 t0 = (box.min - origin) * invDir;
+        const glm::vec3 t1 = (box.max - origin) * invDir;
+        const glm::vec3 tMin = glm::min(t0, t1);
+        const glm::vec3 tMax = glm::max(t0, t1);
+
+        const float tEnter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        const float tExit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+        return (tEnter <= tExit) ? (tEnter) : (-1.0f);
+    }
+};
+
+struct Frustum {
+    // left, right, bottom, top, near, far. Normals point inward.
+    std::array<glm::vec4, 6> planes;
+
+    // Expects a zero-to-one depth projection, as produced by Camera::getGPUCameraData
+    static Frustum fromViewProj(const glm::mat4 &viewproj) noexcept
+    {
+        const glm::vec4 row0(viewproj[0][0], viewproj[1][0], viewproj[2][0], viewproj[3][0]);
+        const glm::vec4 row1(viewproj[0][1], viewproj[1][1], viewproj[2][1], viewproj[3][1]);
+        const glm::vec4 row2(viewproj[0][2], viewproj[1][2], viewproj[2][2], viewproj[3][2]);
+        const glm::vec4 row3(viewproj[0][3], viewproj[1][3], viewproj[2][3], viewproj[3][3]);
+
+        Frustum frustum{
+            .planes =
+                {
+                    row3 + row0,
+                    row3 - row0,
+                    row3 + row1,
+                    row3 - row1,
+                    row2,
+                    row3 - row2,
+                },
+        };
+        for (auto &plane: frustum.planes) { plane /= glm::length(glm::vec3(plane)); }
+        return frustum;
+    }
+
+    bool intersects(const AABB &box) const noexcept
+    {
+        const glm::vec3 center = box.getCenter();
+        const glm::vec3 extent = box.getExtent();
+        for (const auto &plane: planes) {
+            const glm::vec3 normal(plane);
+            const float radius = glm::dot(extent, glm::abs(normal));
+            if (glm::dot(center, normal) + plane.w < -radius) return false;
+        }
+        return true;
+    }
+};
@@ -6,4 +6,24 @@ struct CreationParameters {
     vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
     vk::SampleCountFlagBits msaaSample = vk::SampleCountFlagBits::e1;
     vk::CullModeFlagBits cullMode = vk::CullModeFlagBits::eNone;
+    bool bOcclusionCulling = false;
+    // Submit the whole scene with a single drawIndexedIndirect, when the device supports it
+    bool bMultiDrawIndirect = true;
+    // Capacity of the object buffers, fixed once the application is initialized
+    uint32_t maxObjects = 1000;
+
+    // Falls back to FIFO when the surface does not support it
+    vk::PresentModeKHR presentMode = vk::PresentModeKHR::eMailbox;
+    // 0 requests one image more than the surface minimum
+    uint32_t swapchainImageCount = 0;
+    // Between 1 and MAX_FRAME_FRAME_IN_FLIGHT. Fewer frames lower the latency, more frames smooth the throughput.
+    uint32_t framesInFlight = 3;
+    // Wait for the frame slot before sampling the input, instead of before recording the frame
+    bool bLowLatency = false;
+    // Poll the input again and write the camera right before the submission, instead of before recording the frame
+    bool bLateLatchCamera = false;
+    // 0 renders as fast as the present mode allows
+    uint32_t maxFrameRate = 0;
+    // Fixed steps of the simulation per second, independent of the frame rate
+    uint32_t simulationRate = 60;
 };
@@ -1,17 +1,49 @@
 #pragma once
 
+#include "Camera.hpp"
+#include "FrameArena.hpp"
 #include "types/AllocatedBuffer.hpp"
+#include "types/RenderStats.hpp"
 
+#include <vector>
 #include <vulkan/vulkan.hpp>
 
 struct Frame {
     vk::Semaphore imageAvailableSemaphore;
     vk::Semaphore renderFinishedSemaphore;
-    vk::Fence inFlightFences;
+    // Graphics timeline value signaled by the last submission of this frame
+    uint64_t timelineValue = 0;
+    // The last submission of this frame ran the occlusion culling, which wrote the culling statistics
+    bool bCullingStatsWritten = false;
+    // Reset as a whole once timelineValue is reached
+    vk::CommandPool commandPool = VK_NULL_HANDLE;
+    vk::CommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // Transient CPU data of the frame, reset with the command pool
+    FrameArena arena;
+    // Work of the last submission of this frame
+    RenderStats stats = {};
+    vk::QueryPool statisticsPool = VK_NULL_HANDLE;
     AllocatedBuffer indirectBuffer{};
+    AllocatedBuffer lateIndirectBuffer{};
     struct {
         AllocatedBuffer uniformBuffers{};
         AllocatedBuffer materialBuffer{};
+        AllocatedBuffer instanceBuffer{};
+        AllocatedBuffer objectBatchBuffer{};
+        AllocatedBuffer boundsBuffer{};
+        AllocatedBuffer cullingStatsBuffer{};
+        // Persistently mapped, so the camera can be written after the recording
+        AllocatedBuffer cameraBuffer{};
+        Camera::GPUCameraData *camera = nullptr;
         vk::DescriptorSet objectDescriptor = VK_NULL_HANDLE;
+        vk::DescriptorSet cullingDescriptor = VK_NULL_HANDLE;
     } data = {};
+    // Secondary command buffers, recorded in parallel. Each recording job has its own pool.
+    struct {
+        std::vector<vk::CommandPool> commandPools;
+        // Indexed by render pass, then by pool
+        std::vector<vk::CommandBuffer> drawCommands;
+        vk::CommandPool imguiPool = VK_NULL_HANDLE;
+        vk::CommandBuffer imguiCommand = VK_NULL_HANDLE;
+    } recording = {};
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "types/AABB.hpp"
 #include "types/Vertex.hpp"
 #include <vector>
 
@@ -15,4 +16,5 @@ struct GPUMesh {
     vk::DeviceSize verticiesSize = 0;
     vk::DeviceSize indicesOffset = 0;
     vk::DeviceSize indicesSize = 0;
+    AABB bounds = {};
 };
@@ -1,10 +1,21 @@
 #pragma once
 
+#include "SceneGraph.hpp"
 #include "types/vk_types.hpp"
-#include <string>
+#include <glm/glm.hpp>
+#include <string_view>
 
 struct RenderObject {
-    std::string meshID;
-    std::string objectName = meshID;
+    // Name of a loaded mesh. The string must outlive the object: a key of the loaded meshes, or a literal.
+    std::string_view meshID;
     gpuObject::UniformBufferObject ubo;
+    int32_t proxyID = -1;
+    SceneGraph::NodeID nodeID = SceneGraph::invalidNode;
+    // Large objects (walls, floors, ...) rendered in the CPU occlusion buffer
+    bool bOccluder = false;
+
+    inline glm::mat4 getModelMatrix() const noexcept
+    {
+        return ubo.transform.translation * ubo.transform.rotation * ubo.transform.scale;
+    }
 };
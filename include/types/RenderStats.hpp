@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Work submitted by a frame, counted while it is recorded
+struct RenderStats {
+    uint64_t frameNumber = 0;
+    // Time since the previous frame, in milliseconds
+    float fFrameTime = 0.0f;
+
+    // Draw calls recorded, and the indirect commands they consume
+    uint32_t drawCalls = 0;
+    uint32_t drawCommands = 0;
+    // Before the GPU occlusion culling, which only shows in the pipeline statistics
+    uint32_t instances = 0;
+    uint64_t indices = 0;
+    uint64_t triangles = 0;
+    // Written by the CPU to the per-frame buffers
+    uint64_t uploadedBytes = 0;
+    uint32_t descriptorWrites = 0;
+    uint32_t descriptorBinds = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t dispatches = 0;
+
+    // Pipeline statistics query, when supported. Available once the frame is done on the GPU.
+    struct {
+        uint64_t inputAssemblyPrimitives = 0;
+        uint64_t vertexShaderInvocations = 0;
+        uint64_t clippingInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentShaderInvocations = 0;
+    } pipeline = {};
+};
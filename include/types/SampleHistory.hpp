@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+// Statistics over the last samples of a value, kept in a ring so that adding one does not allocate
+struct SampleHistory {
+    static constexpr size_t historySize = 240;
+
+    // Written at head, the oldest sample is overwritten once full
+    std::array<float, historySize> samples{};
+    size_t head = 0;
+    size_t count = 0;
+
+    float fAverage = 0.0f;
+    float fMin = 0.0f;
+    float fMax = 0.0f;
+    float fMedian = 0.0f;
+    float fPercentile95 = 0.0f;
+    float fPercentile99 = 0.0f;
+
+    // From the oldest sample
+    constexpr float getSample(size_t index) const noexcept
+    {
+        return samples[(head + historySize - count + index) % historySize];
+    }
+
+    // The sorted copy is reused between the calls, reserve it to historySize so the first calls do not allocate
+    void add(float fSample, std::vector<float> &sorted)
+    {
+        samples[head] = fSample;
+        head = (head + 1) % historySize;
+        count = std::min(count + 1, historySize);
+
+        sorted.assign(samples.begin(), samples.begin() + count);
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](float fRatio) { return sorted[static_cast<size_t>(fRatio * (sorted.size() - 1))]; };
+        fAverage = std::accumulate(sorted.begin(), sorted.end(), 0.0f) / sorted.size();
+        fMin = sorted.front();
+        fMax = sorted.back();
+        fMedian = percentile(0.50f);
+        fPercentile95 = percentile(0.95f);
+        fPercentile99 = percentile(0.99f);
+    }
+};
@@ -1,39 +1,87 @@
 #pragma once
 
+#include "AABBTree.hpp"
+#include "SceneGraph.hpp"
+#include "types/AABB.hpp"
 #include "types/RenderObject.hpp"
+#include "types/StringMap.hpp"
 
+#include <algorithm>
+#include <concepts>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
 class Scene
 {
 public:
     struct DrawBatch {
-        std::string meshId;
+        std::string_view meshId;
         uint32_t first;
         uint32_t count;
     };
 
+    // Range of objects [first, last) to upload to the GPU
+    struct DirtyRange {
+        uint32_t first = std::numeric_limits<uint32_t>::max();
+        uint32_t last = 0;
+
+        constexpr bool isEmpty() const noexcept { return first >= last; }
+        constexpr void add(uint32_t begin, uint32_t end) noexcept
+        {
+            first = std::min(first, begin);
+            last = std::max(last, end);
+        }
+        constexpr void add(const DirtyRange &other) noexcept
+        {
+            if (!other.isEmpty()) add(other.first, other.last);
+        }
+    };
+
 public:
     Scene();
     ~Scene();
     inline auto getNbOfObject() const noexcept { return sceneModels.size(); }
-    inline auto &getObject(auto index) { return sceneModels.at(index); }
-    inline void addObject(RenderObject &&obj)
-    {
-        sceneModels.push_back(obj);
-        bNeedRebuild = true;
-    }
-
-    void removeObject(const auto index)
-    {
-        sceneModels.erase(sceneModels.begin() + index);
-        bNeedRebuild = true;
-    }
+    inline const auto &getObject(auto index) const { return sceneModels.at(index); }
+    void addObject(RenderObject &&obj);
+    // Bulk insertion, used when loading a level
+    void addObjects(std::vector<RenderObject> &&objects);
+    void removeObject(const uint32_t index);
+    // Objects attached to the scene graph are moved through their node instead
+    void updateObject(const uint32_t index, const gpuObject::UniformBufferObject &ubo);
+
+    // Make the object a node of the scene graph, its current transform becoming relative to the parent node.
+    // Removing the object keeps the node, so its children are not affected.
+    SceneGraph::NodeID attachObject(const uint32_t index, SceneGraph::NodeID parent = SceneGraph::invalidNode);
+    // Destroy the node and its children. The objects attached to them keep their last transform, and are detached.
+    void destroyNode(SceneGraph::NodeID node);
+    // The nodes must be destroyed through the scene, so the objects do not keep a recycled ID
+    constexpr SceneGraph &getGraph() noexcept { return graph; }
+    // Rebuild the draw batches if needed, propagate the scene graph transforms, and return the objects modified
+    // since the last call
+    DirtyRange update();
+    // Mark every object as modified
+    inline void invalidate() noexcept { dirtyObjects.add(0, sceneModels.size()); }
+
+    inline void setMeshBounds(const std::string &meshID, const AABB &bounds) { meshBounds[meshID] = bounds; }
+    AABB getObjectBounds(const RenderObject &obj) const;
+
+    // The callbacks receive the object index, and return false to stop the query
+    template <std::predicate<uint32_t> Callback>
+    void queryFrustum(const Frustum &frustum, Callback &&callback) const;
+    template <std::predicate<uint32_t> Callback>
+    void queryBox(const AABB &box, Callback &&callback) const;
+    // Return the index of the closest object hit by the ray, if any
+    std::optional<uint32_t> rayCast(const Ray &ray) const;
+    constexpr const AABBTree &getSpatialIndex() const noexcept { return spatialIndex; }
 
     const std::vector<DrawBatch> &getDrawBatch(const bool bForceRebuild = false);
 
 private:
     void buildDrawBatch();
+    void setObjectIndex(const uint32_t index);
 
 public:
     bool bNeedRebuild = true;
@@ -41,4 +89,20 @@ public:
 private:
     std::vector<RenderObject> sceneModels;
     std::vector<DrawBatch> cachedBatch;
+    StringMap<AABB> meshBounds;
+    AABBTree spatialIndex;
+    SceneGraph graph;
+    DirtyRange dirtyObjects;
 };
+
+template <std::predicate<uint32_t> Callback>
+void Scene::queryFrustum(const Frustum &frustum, Callback &&callback) const
+{
+    spatialIndex.query(frustum, [&](int32_t proxyID) { return callback(spatialIndex.getUserData(proxyID)); });
+}
+
+template <std::predicate<uint32_t> Callback>
+void Scene::queryBox(const AABB &box, Callback &&callback) const
+{
+    spatialIndex.query(box, [&](int32_t proxyID) { return callback(spatialIndex.getUserData(proxyID)); });
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct StringHash {
+    using is_transparent = void;
+
+    inline size_t operator()(std::string_view str) const noexcept { return std::hash<std::string_view>{}(str); }
+};
+
+// Map keyed by name, which can be looked up with a view without building a std::string
+template <typename T>
+class StringMap : public std::unordered_map<std::string, T, StringHash, std::equal_to<>>
+{
+public:
+    inline T &at(std::string_view key)
+    {
+        auto iter = this->find(key);
+        if (iter == this->end()) throw std::out_of_range("unknown key " + std::string(key));
+        return iter->second;
+    }
+    inline const T &at(std::string_view key) const
+    {
+        auto iter = this->find(key);
+        if (iter == this->end()) throw std::out_of_range("unknown key " + std::string(key));
+        return iter->second;
+    }
+};
@@ -17,4 +17,18 @@ struct UniformBufferObject {
     uint32_t materialIndex = 0;
 };
 
+struct Bounds {
+    glm::vec4 min;
+    glm::vec4 max;
+};
+
+// Batch of the objects the CPU already culled, skipped by the culling shader
+constexpr uint32_t culledObjectBatch = 0xFFFFFFFF;
+
+struct CullingStats {
+    uint32_t testedObjects = 0;
+    uint32_t occludedObjects = 0;
+    uint32_t lateDraws = 0;
+};
+
 }    // namespace gpuObject
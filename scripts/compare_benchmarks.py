@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""Compare two benchmark reports written by `doon -b`, and flag the metrics that regressed."""
+
+import argparse
+import json
+import sys
+
+METRICS = ["frame_time_ms", "cpu_time_ms", "gpu_time_ms", "present_interval_ms"]
+# The maximum is a single frame, too noisy to fail on
+CHECKED_STATS = ["mean", "p50", "p95", "p99"]
+STATS = CHECKED_STATS + ["max"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("baseline", help="reference report")
+    parser.add_argument("candidate", help="report to check")
+    parser.add_argument("-t", "--threshold", type=float, default=5.0,
+                        help="relative increase flagged as a regression, in percent (default: 5)")
+    args = parser.parse_args()
+
+    with open(args.baseline) as file:
+        baseline = json.load(file)
+    with open(args.candidate) as file:
+        candidate = json.load(file)
+    if baseline.get("path") != candidate.get("path"):
+        print(f"warning: the reports replay different paths ({baseline.get('path')} and {candidate.get('path')})")
+
+    regressions = 0
+    print(f"{'metric':<22}{'stat':<6}{'baseline':>12}{'candidate':>12}{'change':>10}")
+    for metric in METRICS:
+        if metric not in baseline or metric not in candidate:
+            continue
+        for stat in STATS:
+            before = baseline[metric][stat]
+            after = candidate[metric][stat]
+            change = (after - before) / before * 100.0 if before > 0 else 0.0
+            flag = ""
+            if stat in CHECKED_STATS and change > args.threshold:
+                flag = "  REGRESSION"
+                regressions += 1
+            print(f"{metric:<22}{stat:<6}{before:>12.3f}{after:>12.3f}{change:>+9.1f}%{flag}")
+
+    if regressions > 0:
+        print(f"{regressions} regression(s) above {args.threshold}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -12,7 +12,7 @@ layout(location = 5) flat in uint materialIndex;
 
 layout(location = 0) out vec4 outColor;
 
-layout (push_constant) uniform constants {
+layout (std140, set = 0, binding = 3) uniform CameraBuffer {
     vec4 position;
 	mat4 viewproj;
 } cameraData;
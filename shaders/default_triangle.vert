@@ -29,14 +29,21 @@ layout (std140, set = 0, binding = 0) readonly buffer ObjectBuffer {
     UniformBufferObject objects[];
 } objectBuffer;
 
-layout (push_constant) uniform constants {
+// Object index of each instance, so a batch can draw a culled subset of its objects
+layout (std430, set = 0, binding = 2) readonly buffer InstanceBuffer {
+    uint objectIndex[];
+} instanceBuffer;
+
+// Written right before the submission when the camera is late latched
+layout (std140, set = 0, binding = 3) uniform CameraBuffer {
     vec4 position;
 	mat4 viewproj;
 } cameraData;
 
 
 void main() {
-    Transform ubo = objectBuffer.objects[gl_BaseInstance].transform;
+    uint objectIndex = instanceBuffer.objectIndex[gl_InstanceIndex];
+    Transform ubo = objectBuffer.objects[objectIndex].transform;
     mat4 modelMatrix = ubo.translation * ubo.rotation  * ubo.scale;
 
     gl_Position = cameraData.viewproj * modelMatrix * vec4(inPosition, 1.0);
@@ -45,6 +52,6 @@ void main() {
     fragPosition = vec3(modelMatrix * vec4(inPosition, 1.0));
     fragNormal = mat3(transpose(inverse(modelMatrix))) * inNormal;
     fragTextCoords = inTextCoords;
-    textureIndex = objectBuffer.objects[gl_BaseInstance].textureIndex;
-    materialIndex = objectBuffer.objects[gl_BaseInstance].materialIndex;
+    textureIndex = objectBuffer.objects[objectIndex].textureIndex;
+    materialIndex = objectBuffer.objects[objectIndex].materialIndex;
 }
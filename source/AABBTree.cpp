@@ -0,0 +1,328 @@
+#include "AABBTree.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <tuple>
+#include <utility>
+
+static AABB fattenAABB(const AABB &aabb, float margin)
+{
+    return {
+        .min = aabb.min - glm::vec3(margin),
+        .max = aabb.max + glm::vec3(margin),
+    };
+}
+
+AABBTree::AABBTree() {}
+
+AABBTree::~AABBTree() {}
+
+int32_t AABBTree::createProxy(const AABB &aabb, uint32_t userData)
+{
+    const int32_t proxyId = allocateNode();
+
+    nodes[proxyId].aabb = fattenAABB(aabb, aabbMargin);
+    nodes[proxyId].userData = userData;
+    nodes[proxyId].height = 0;
+    insertLeaf(proxyId);
+    proxyCount++;
+    return proxyId;
+}
+
+void AABBTree::createProxies(std::span<const AABB> aabbs, uint32_t firstUserData, std::span<int32_t> proxyIds)
+{
+    assert(aabbs.size() == proxyIds.size());
+    if (aabbs.empty()) return;
+
+    nodes.reserve(nodes.size() + aabbs.size() * 2);
+    for (size_t i = 0; i < aabbs.size(); i++) {
+        const int32_t proxyId = allocateNode();
+        nodes[proxyId].aabb = fattenAABB(aabbs[i], aabbMargin);
+        nodes[proxyId].userData = firstUserData + i;
+        nodes[proxyId].height = 0;
+        proxyIds[i] = proxyId;
+    }
+    proxyCount += aabbs.size();
+
+    std::vector<int32_t> leaves(proxyIds.begin(), proxyIds.end());
+    const int32_t subtree = buildSubtree(leaves);
+    if (root == nullNode) {
+        root = subtree;
+        nodes[root].parent = nullNode;
+    } else {
+        insertLeaf(subtree);
+    }
+}
+
+void AABBTree::destroyProxy(int32_t proxyId)
+{
+    assert(nodes.at(proxyId).isLeaf());
+    removeLeaf(proxyId);
+    freeNode(proxyId);
+    proxyCount--;
+}
+
+bool AABBTree::moveProxy(int32_t proxyId, const AABB &aabb, const glm::vec3 &displacement)
+{
+    assert(nodes.at(proxyId).isLeaf());
+    AABB fatAABB = fattenAABB(aabb, aabbMargin);
+
+    // Predict the movement, so fast objects are not reinserted every frame
+    const glm::vec3 d = displacement * aabbDisplacementMultiplier;
+    fatAABB.min += glm::min(d, glm::vec3(0.0f));
+    fatAABB.max += glm::max(d, glm::vec3(0.0f));
+
+    const AABB &treeAABB = nodes[proxyId].aabb;
+    if (treeAABB.contains(aabb)) {
+        // Still inside the fat AABB, unless it became too large (the object slowed down)
+        const AABB hugeAABB = fattenAABB(fatAABB, 4.0f * aabbMargin);
+        if (hugeAABB.contains(treeAABB)) return false;
+    }
+
+    removeLeaf(proxyId);
+    nodes[proxyId].aabb = fatAABB;
+    insertLeaf(proxyId);
+    return true;
+}
+
+void AABBTree::clear()
+{
+    nodes.clear();
+    root = nullNode;
+    freeList = nullNode;
+    proxyCount = 0;
+}
+
+float AABBTree::getAreaRatio() const noexcept
+{
+    if (root == nullNode) return 0.0f;
+
+    float totalArea = 0.0f;
+    for (const auto &node: nodes) {
+        if (node.height > 0) totalArea += node.aabb.getArea();
+    }
+    return totalArea / nodes[root].aabb.getArea();
+}
+
+int32_t AABBTree::allocateNode()
+{
+    if (freeList == nullNode) {
+        nodes.emplace_back();
+        nodes.back().next = nullNode;
+        return static_cast<int32_t>(nodes.size() - 1);
+    }
+    const int32_t nodeId = freeList;
+    freeList = nodes[nodeId].next;
+    nodes[nodeId] = Node{};
+    nodes[nodeId].parent = nullNode;
+    return nodeId;
+}
+
+void AABBTree::freeNode(int32_t nodeId)
+{
+    nodes[nodeId].next = freeList;
+    nodes[nodeId].height = -1;
+    freeList = nodeId;
+}
+
+int32_t AABBTree::findBestSibling(const AABB &leafAABB)
+{
+    // Branch and bound search of the sibling that minimise the total surface area of the tree
+    const float leafArea = leafAABB.getArea();
+    int32_t bestSibling = root;
+    float bestCost = AABB::combine(nodes[root].aabb, leafAABB).getArea();
+
+    insertionStack.clear();
+    insertionStack.emplace_back(root, 0.0f);
+    while (!insertionStack.empty()) {
+        const auto [index, inheritedCost] = insertionStack.back();
+        insertionStack.pop_back();
+
+        const Node &node = nodes[index];
+        const float directCost = AABB::combine(node.aabb, leafAABB).getArea();
+        const float cost = directCost + inheritedCost;
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSibling = index;
+        }
+
+        // Every ancestor of a child of this node has to be enlarged by at least that much
+        const float childInheritedCost = inheritedCost + directCost - node.aabb.getArea();
+        if (node.isLeaf() || leafArea + childInheritedCost >= bestCost) continue;
+
+        // Visit the most promising child first, so the bound tightens quickly
+        int32_t first = node.child1;
+        int32_t second = node.child2;
+        if (AABB::combine(nodes[first].aabb, leafAABB).getArea() >
+            AABB::combine(nodes[second].aabb, leafAABB).getArea()) {
+            std::swap(first, second);
+        }
+        insertionStack.emplace_back(second, childInheritedCost);
+        insertionStack.emplace_back(first, childInheritedCost);
+    }
+    return bestSibling;
+}
+
+// Top-down build, splitting the leaves at the median of the largest axis of their centers
+int32_t AABBTree::buildSubtree(std::span<int32_t> leaves)
+{
+    if (leaves.size() == 1) return leaves[0];
+
+    AABB centers;
+    for (const int32_t leaf: leaves) { centers.extend(nodes[leaf].aabb.getCenter()); }
+    const glm::vec3 size = centers.max - centers.min;
+    const unsigned axis = (size.x > size.y && size.x > size.z) ? (0) : ((size.y > size.z) ? (1) : (2));
+
+    const auto middle = leaves.begin() + leaves.size() / 2;
+    // Comparing min + max is the same as comparing the centers
+    std::nth_element(leaves.begin(), middle, leaves.end(), [&](int32_t a, int32_t b) {
+        return nodes[a].aabb.min[axis] + nodes[a].aabb.max[axis] < nodes[b].aabb.min[axis] + nodes[b].aabb.max[axis];
+    });
+
+    const int32_t child1 = buildSubtree(leaves.first(leaves.size() / 2));
+    const int32_t child2 = buildSubtree(leaves.subspan(leaves.size() / 2));
+    const int32_t parent = allocateNode();
+    nodes[parent].child1 = child1;
+    nodes[parent].child2 = child2;
+    nodes[parent].aabb = AABB::combine(nodes[child1].aabb, nodes[child2].aabb);
+    nodes[parent].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+    nodes[child1].parent = parent;
+    nodes[child2].parent = parent;
+    return parent;
+}
+
+void AABBTree::insertLeaf(int32_t leaf)
+{
+    if (root == nullNode) {
+        root = leaf;
+        nodes[root].parent = nullNode;
+        return;
+    }
+
+    const AABB leafAABB = nodes[leaf].aabb;
+    const int32_t sibling = findBestSibling(leafAABB);
+
+    const int32_t oldParent = nodes[sibling].parent;
+    const int32_t newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].aabb = AABB::combine(leafAABB, nodes[sibling].aabb);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != nullNode) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+    } else {
+        root = newParent;
+    }
+    refitAncestors(nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int32_t leaf)
+{
+    if (leaf == root) {
+        root = nullNode;
+        return;
+    }
+
+    const int32_t parent = nodes[leaf].parent;
+    const int32_t grandParent = nodes[parent].parent;
+    const int32_t sibling = (nodes[parent].child1 == leaf) ? (nodes[parent].child2) : (nodes[parent].child1);
+
+    if (grandParent != nullNode) {
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        } else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitAncestors(grandParent);
+    } else {
+        root = sibling;
+        nodes[sibling].parent = nullNode;
+        freeNode(parent);
+    }
+}
+
+void AABBTree::refitAncestors(int32_t index)
+{
+    while (index != nullNode) {
+        index = balance(index);
+
+        Node &node = nodes[index];
+        const Node &child1 = nodes[node.child1];
+        const Node &child2 = nodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.aabb = AABB::combine(child1.aabb, child2.aabb);
+
+        index = node.parent;
+    }
+}
+
+// Perform a left or right rotation if node A is imbalanced, and return the new root of the subtree
+int32_t AABBTree::balance(int32_t iA)
+{
+    Node *A = &nodes[iA];
+    if (A->isLeaf() || A->height < 2) return iA;
+
+    const int32_t iB = A->child1;
+    const int32_t iC = A->child2;
+    Node *B = &nodes[iB];
+    Node *C = &nodes[iC];
+
+    const int32_t balance = C->height - B->height;
+
+    auto rotate = [&](int32_t iUp, Node *up, Node *other, bool bUpIsChild2) {
+        const int32_t iF = up->child1;
+        const int32_t iG = up->child2;
+        Node *F = &nodes[iF];
+        Node *G = &nodes[iG];
+
+        // Swap A and the promoted child
+        up->child1 = iA;
+        up->parent = A->parent;
+        A->parent = iUp;
+
+        if (up->parent != nullNode) {
+            if (nodes[up->parent].child1 == iA) {
+                nodes[up->parent].child1 = iUp;
+            } else {
+                nodes[up->parent].child2 = iUp;
+            }
+        } else {
+            root = iUp;
+        }
+
+        // Keep the tallest grandchild under the promoted node
+        auto [iKeep, keep, iMove, move] =
+            (F->height > G->height) ? (std::tuple{iF, F, iG, G}) : (std::tuple{iG, G, iF, F});
+        up->child2 = iKeep;
+        if (bUpIsChild2) {
+            A->child2 = iMove;
+        } else {
+            A->child1 = iMove;
+        }
+        move->parent = iA;
+        A->aabb = AABB::combine(other->aabb, move->aabb);
+        up->aabb = AABB::combine(A->aabb, keep->aabb);
+        A->height = 1 + std::max(other->height, move->height);
+        up->height = 1 + std::max(A->height, keep->height);
+    };
+
+    if (balance > 1) {
+        rotate(iC, C, B, true);
+        return iC;
+    }
+    if (balance < -1) {
+        rotate(iB, B, C, false);
+        return iB;
+    }
+    return iA;
+}
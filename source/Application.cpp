@@ -7,8 +7,10 @@
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
 #include <chrono>
+#include <cinttypes>
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -17,11 +19,13 @@
 #include <imgui.h>
 #include <math.h>
 #include <memory>
+#include <numeric>
 #include <sstream>
 #include <stb_image.h>
 #include <stdexcept>
 #include <stdio.h>
 #include <string>
+#include <thread>
 #include <tiny_obj_loader.h>
 #include <type_traits>
 #include <unordered_map>
@@ -30,6 +34,8 @@
 
 #include "Camera.hpp"
 #include "DebugMacros.hpp"
+#include "Profiler.hpp"
+#include "SceneFile.hpp"
 #include "Swapchain.hpp"
 #include "Window.hpp"
 #include "types/AllocatedBuffer.hpp"
@@ -41,7 +47,25 @@
 #include "vk_init.hpp"
 #include "vk_utils.hpp"
 
-Application::Application(): player()
+static void writeRenderStatsHeader(std::ostream &stream)
+{
+    stream << "frame,frame_time_ms,draw_calls,draw_commands,instances,indices,triangles,uploaded_bytes,"
+              "descriptor_writes,descriptor_binds,pipeline_binds,dispatches,ia_primitives,vs_invocations,"
+              "clipping_invocations,clipping_primitives,fs_invocations\n";
+}
+
+static void writeRenderStats(std::ostream &stream, const RenderStats &stats)
+{
+    stream << stats.frameNumber << "," << stats.fFrameTime << "," << stats.drawCalls << "," << stats.drawCommands
+           << "," << stats.instances << "," << stats.indices << "," << stats.triangles << "," << stats.uploadedBytes
+           << "," << stats.descriptorWrites << "," << stats.descriptorBinds << "," << stats.pipelineBinds << ","
+           << stats.dispatches << "," << stats.pipeline.inputAssemblyPrimitives << ","
+           << stats.pipeline.vertexShaderInvocations << "," << stats.pipeline.clippingInvocations << ","
+           << stats.pipeline.clippingPrimitives << "," << stats.pipeline.fragmentShaderInvocations << "\n";
+}
+
+Application::Application(bool bHeadless, const CreationParameters &parameters)
+    : VulkanApplication(bHeadless, parameters), player(), occlusionRasterizer(jobSystem)
 {
     DEBUG_FUNCTION
     window.setUserPointer(this);
@@ -49,6 +73,13 @@ Application::Application(): player()
     window.setKeyCallback(Application::keyboard_callback);
     window.setCursorPosCallback(Application::cursor_callback);
     window.setTitle(uiRessources.sWindowTitle);
+
+    // Default material, known before a scene refers to it
+    materials.push_back({
+        .ambientColor = {1.0f, 1.0f, 1.0f, 1.0f},
+        .diffuse = {1.0f, 1.0f, 1.0f, 1.0f},
+        .specular = {1.0f, 1.0f, 1.0f, 1.0f},
+    });
 }
 
 Application::~Application()
@@ -61,75 +92,92 @@ Application::~Application()
 void Application::loadModel()
 {
     DEBUG_FUNCTION
-    std::vector<Vertex> vertexStagingBuffer;
-    std::vector<uint32_t> indexStagingBuffer;
+    PROFILE_FUNCTION;
+    std::vector<std::filesystem::path> files;
+    for (const auto &file: std::filesystem::directory_iterator("../models")) {
+        if (file.path().extension() == ".obj") files.push_back(file.path());
+    }
 
-    auto iterator = std::filesystem::directory_iterator("../models");
-    auto distance = std::distance(begin(iterator), {});
+    // The files are parsed in parallel, then packed in the vertex and index buffers
+    std::vector<CPUMesh> cpuMeshes(files.size());
+    std::vector<std::string> warnings(files.size());
+    jobSystem.parallelFor(files.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t f = begin; f < end; f++) {
+            PROFILE_SCOPE("Parse OBJ");
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string err;
 
-    auto &bar = logger->newProgressBar("Model", distance);
-    for (const auto &file: std::filesystem::directory_iterator("../models")) {
+            tinyobj::LoadObj(&attrib, &shapes, &materials, &warnings[f], &err, files[f].c_str(), nullptr);
+            if (!err.empty()) {
+                throw std::runtime_error("Error while loading obj file " + files[f].string() + ": " + err);
+            }
+
+            auto &cpuMesh = cpuMeshes[f];
+            std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+            for (const auto &shape: shapes) {
+                for (const auto &index: shape.mesh.indices) {
+                    Vertex vertex;
+                    vertex.pos = {
+                        attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2],
+                    };
+                    vertex.color = {1.0f, 1.0f, 1.0f};
+
+                    if (!attrib.normals.empty()) {
+                        vertex.normal = {
+                            attrib.normals[3 * index.normal_index + 0],
+                            attrib.normals[3 * index.normal_index + 1],
+                            attrib.normals[3 * index.normal_index + 2],
+                        };
+                    }
+                    if (!attrib.texcoords.empty()) {
+                        vertex.texCoord = {
+                            attrib.texcoords[2 * index.texcoord_index + 0],
+                            1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
+                        };
+                    }
+
+                    if (!uniqueVertices.contains(vertex)) {
+                        uniqueVertices[vertex] = cpuMesh.verticies.size();
+                        cpuMesh.verticies.push_back(vertex);
+                    }
+                    cpuMesh.indices.push_back(uniqueVertices.at(vertex));
+                }
+            }
+        }
+    });
+
+    std::vector<Vertex> vertexStagingBuffer;
+    std::vector<uint32_t> indexStagingBuffer;
+    auto &bar = logger->newProgressBar("Model", files.size());
+    for (size_t f = 0; f < files.size(); f++) {
         ++bar;
-        if (file.path().extension() != ".obj") { continue; }
-        logger->info("LOADING") << "Loading object: " << file.path();
+        logger->info("LOADING") << "Loading object: " << files[f];
         LOGGER_ENDL;
+        if (!warnings[f].empty()) {
+            logger->warn("LOADING_OBJ") << warnings[f];
+            LOGGER_ENDL;
+        }
 
+        auto &cpuMesh = cpuMeshes[f];
         GPUMesh mesh{
             .verticiesOffset = vertexStagingBuffer.size(),
+            .verticiesSize = cpuMesh.verticies.size(),
             .indicesOffset = indexStagingBuffer.size(),
+            .indicesSize = cpuMesh.indices.size(),
         };
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> shapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-
-        tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, file.path().c_str(), nullptr);
-        if (!warn.empty()) {
-            logger->warn("LOADING_OBJ") << warn;
-            LOGGER_ENDL;
-        }
-        if (!err.empty()) {
-            logger->err("LOADING_OBJ") << err;
-            LOGGER_ENDL;
-            throw std::runtime_error("Error while loading obj file");
-        }
-
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-        for (const auto &shape: shapes) {
-            for (const auto &index: shape.mesh.indices) {
-                Vertex vertex;
-                vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2],
-                };
-                vertex.color = {1.0f, 1.0f, 1.0f};
-
-                if (!attrib.normals.empty()) {
-                    vertex.normal = {
-                        attrib.normals[3 * index.normal_index + 0],
-                        attrib.normals[3 * index.normal_index + 1],
-                        attrib.normals[3 * index.normal_index + 2],
-                    };
-                }
-                if (!attrib.texcoords.empty()) {
-                    vertex.texCoord = {
-                        attrib.texcoords[2 * index.texcoord_index + 0],
-                        1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
-                    };
-                }
+        for (const auto &vertex: cpuMesh.verticies) { mesh.bounds.extend(vertex.pos); }
+        vertexStagingBuffer.insert(vertexStagingBuffer.end(), cpuMesh.verticies.begin(), cpuMesh.verticies.end());
+        indexStagingBuffer.insert(indexStagingBuffer.end(), cpuMesh.indices.begin(), cpuMesh.indices.end());
+        scene.setMeshBounds(files[f].stem(), mesh.bounds);
 
-                if (!uniqueVertices.contains(vertex)) {
-                    uniqueVertices[vertex] = vertexStagingBuffer.size() - mesh.verticiesOffset;
-                    vertexStagingBuffer.push_back(vertex);
-                }
-                indexStagingBuffer.push_back(uniqueVertices.at(vertex));
-            }
-        }
-        mesh.indicesSize = indexStagingBuffer.size() - mesh.indicesOffset;
-        mesh.verticiesSize = vertexStagingBuffer.size() - mesh.verticiesOffset;
-        loadedMeshes[file.path().stem()] = mesh;
+        auto &occluder = occluderMeshes[files[f].stem()];
+        for (const auto &vertex: cpuMesh.verticies) { occluder.positions.push_back(vertex.pos); }
+        occluder.indices = std::move(cpuMesh.indices);
+        loadedMeshes[files[f].stem()] = mesh;
     }
     auto vertexSize = vertexStagingBuffer.size() * sizeof(Vertex);
     auto stagingVertex = createBuffer(vertexSize, vk::BufferUsageFlagBits::eTransferSrc, vma::MemoryUsage::eCpuToGpu);
@@ -159,25 +207,47 @@ void Application::loadModel()
 void Application::loadTextures()
 {
     DEBUG_FUNCTION
-    auto iterator = std::filesystem::directory_iterator("../textures");
-    auto distance = std::distance(begin(iterator), end(iterator));
+    PROFILE_FUNCTION;
+    struct DecodedTexture {
+        stbi_uc *pixels = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+    std::vector<std::filesystem::path> files;
+    for (const auto &f: std::filesystem::directory_iterator("../textures")) { files.push_back(f.path()); }
+
+    // The images are decoded in parallel, the upload stays on this thread as it uses the transfer command pool
+    std::vector<DecodedTexture> decoded(files.size());
+    try {
+        jobSystem.parallelFor(files.size(), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t f = begin; f < end; f++) {
+                PROFILE_SCOPE("Decode texture");
+                int texChannels;
+                auto &texture = decoded[f];
+                texture.pixels =
+                    stbi_load(files[f].c_str(), &texture.width, &texture.height, &texChannels, STBI_rgb_alpha);
+                if (!texture.pixels) throw std::runtime_error("failed to load texture image");
+            }
+        });
+    } catch (...) {
+        for (auto &texture: decoded) { stbi_image_free(texture.pixels); }
+        throw;
+    }
 
-    auto &bar = logger->newProgressBar("Texture", distance);
-    for (auto &f: std::filesystem::directory_iterator("../textures")) {
+    auto &bar = logger->newProgressBar("Texture", files.size());
+    for (size_t f = 0; f < files.size(); f++) {
         ++bar;
 
-        logger->info("LOADING") << "Loading texture: " << f.path();
+        logger->info("LOADING") << "Loading texture: " << files[f];
         LOGGER_ENDL;
-        int texWidth, texHeight, texChannels;
-        stbi_uc *pixels = stbi_load(f.path().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        const int texWidth = decoded[f].width;
+        const int texHeight = decoded[f].height;
         vk::DeviceSize imageSize = texWidth * texHeight * 4;
 
-        if (!pixels) throw std::runtime_error("failed to load texture image");
-
         AllocatedBuffer stagingBuffer{};
         stagingBuffer = createBuffer(imageSize, vk::BufferUsageFlagBits::eTransferSrc, vma::MemoryUsage::eCpuToGpu);
-        copyBuffer(stagingBuffer, pixels, imageSize);
-        stbi_image_free(pixels);
+        copyBuffer(stagingBuffer, decoded[f].pixels, imageSize);
+        stbi_image_free(decoded[f].pixels);
 
         mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
         AllocatedImage image{};
@@ -215,7 +285,7 @@ void Application::loadTextures()
         //                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
         allocator.destroyBuffer(stagingBuffer.buffer, stagingBuffer.memory);
         generateMipmaps(image.image, vk::Format::eR8G8B8A8Srgb, texWidth, texHeight, mipLevels);
-        loadedTextures.insert({f.path().stem(), std::move(image)});
+        loadedTextures.insert({files[f].stem(), std::move(image)});
     }
     logger->deleteProgressBar(bar);
     applicationDeletionQueue.push([&] {
@@ -226,84 +296,139 @@ void Application::loadTextures()
     });
 }
 
-void Application::run()
+void Application::loadScene(const std::filesystem::path &path)
 {
-    DEBUG_FUNCTION;
-    unsigned failedFrames = 0;
-    float fElapsedTime = 0;
+    DEBUG_FUNCTION
+    auto tp1 = std::chrono::high_resolution_clock::now();
+    SceneFile file(path);
+    const auto &header = file.getHeader();
+    if (scene.getNbOfObject() + header.objectCount > creationParameters.maxObjects) {
+        throw std::runtime_error("scene has too many objects: " + std::to_string(header.objectCount) +
+                                 ", the capacity is " + std::to_string(creationParameters.maxObjects));
+    }
 
-    scene.addObject({
-        .meshID = "plane",
-        .ubo =
-            {
-                .transform =
-                    {
-                        .translation = glm::translate(glm::mat4{1.0f}, glm::vec3(0.0f, 0.0f, 0.0f)),
-                        .rotation = glm::toMat4(glm::quat(glm::vec3(0, 0, 0))),
-                        .scale = glm::scale(glm::mat4{1.0f}, glm::vec3(1.0f)),
-                    },
-                .textureIndex = 3,
-            },
-    });
-    scene.addObject({
-        .meshID = "ferdelance",
-        .ubo =
-            {
-                .transform =
-                    {
-                        .translation = glm::translate(glm::mat4{1.0f}, glm::vec3(0.0f, 0.0f, 75.0f)),
-                        .rotation = glm::toMat4(glm::quat(glm::vec3(0, 0, 0))),
-                        .scale = glm::scale(glm::mat4{1.0f}, glm::vec3(0.5f)),
-                    },
-                .textureIndex = 1,
-            },
-    });
-    scene.addObject({
-        .meshID = "cube",
-        .ubo =
-            {
-                .transform =
-                    {
-                        .translation = glm::translate(glm::mat4{1.0f}, glm::vec3(-10.0f, 2.f, 0.0f)),
-                        .rotation = glm::toMat4(glm::quat(glm::vec3(-(M_PI / 2), 0, 0))),
-                        .scale = glm::scale(glm::mat4{1.0f}, glm::vec3(2.0f)),
-                    },
-                .textureIndex = 0,
-            },
-    });
+    // The texture table stores names, resolve them to the order used by the texture descriptor set
+    std::unordered_map<std::string, uint32_t> textureSlots;
+    for (const auto &[name, _]: loadedTextures) { textureSlots.emplace(name, textureSlots.size()); }
+    std::vector<uint32_t> textureRemap(header.textureCount);
+    for (uint32_t i = 0; i < header.textureCount; i++) {
+        auto slot = textureSlots.find(std::string(file.getTextureName(i)));
+        if (slot == textureSlots.end()) {
+            throw std::runtime_error("unknown texture in scene: " + std::string(file.getTextureName(i)));
+        }
+        textureRemap[i] = slot->second;
+    }
+    // The objects view the names of the loaded meshes, which outlive them
+    std::vector<std::string_view> meshNames(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        const auto mesh = loadedMeshes.find(file.getMeshName(i));
+        if (mesh == loadedMeshes.end()) {
+            throw std::runtime_error("unknown mesh in scene: " + std::string(file.getMeshName(i)));
+        }
+        meshNames[i] = mesh->first;
+    }
 
-    materials.push_back({
-        .ambientColor = {1.0f, 1.0f, 1.0f, 1.0f},
-        .diffuse = {1.0f, 1.0f, 1.0f, 1.0f},
-        .specular = {1.0f, 1.0f, 1.0f, 1.0f},
-    });
+    const auto objects = file.getObjects();
+    const auto infos = file.getObjectInfos();
+    std::vector<RenderObject> sceneObjects;
+    sceneObjects.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (objects[i].materialIndex >= materials.size()) {
+            throw std::runtime_error("invalid material index in scene: " + std::to_string(objects[i].materialIndex));
+        }
+        sceneObjects.push_back({
+            .meshID = meshNames[infos[i].meshIndex],
+            .ubo = objects[i],
+            .bOccluder = (infos[i].flags & SceneFile::Occluder) != 0,
+        });
+        sceneObjects.back().ubo.textureIndex = textureRemap[objects[i].textureIndex];
+    }
+    scene.addObjects(std::move(sceneObjects));
 
-    void *objectData = nullptr;
-    for (auto &frame: frames) {
-        allocator.mapMemory(frame.data.materialBuffer.memory, &objectData);
-        auto *objectSSBI = (gpuObject::Material *)objectData;
-        for (unsigned i = 0; i < materials.size(); i++) { objectSSBI[i] = materials.at(i); }
-        allocator.unmapMemory(frame.data.materialBuffer.memory);
+    std::chrono::duration<float, std::milli> elapsedTime(std::chrono::high_resolution_clock::now() - tp1);
+    logger->info("LOADING") << "Loaded " << header.objectCount << " objects from " << path << " in "
+                            << elapsedTime.count() << "ms";
+    LOGGER_ENDL;
+}
+
+void Application::run(std::optional<uint64_t> frameLimit, Benchmark *benchmark)
+{
+    DEBUG_FUNCTION;
+    unsigned failedFrames = 0;
+
+    // Default scene, when none was loaded
+    if (scene.getNbOfObject() == 0) {
+        scene.addObject({
+            .meshID = "plane",
+            .ubo =
+                {
+                    .transform =
+                        {
+                            .translation = glm::translate(glm::mat4{1.0f}, glm::vec3(0.0f, 0.0f, 0.0f)),
+                            .rotation = glm::toMat4(glm::quat(glm::vec3(0, 0, 0))),
+                            .scale = glm::scale(glm::mat4{1.0f}, glm::vec3(1.0f)),
+                        },
+                    .textureIndex = 3,
+                },
+            .bOccluder = true,
+        });
+        scene.addObject({
+            .meshID = "ferdelance",
+            .ubo =
+                {
+                    .transform =
+                        {
+                            .translation = glm::translate(glm::mat4{1.0f}, glm::vec3(0.0f, 0.0f, 75.0f)),
+                            .rotation = glm::toMat4(glm::quat(glm::vec3(0, 0, 0))),
+                            .scale = glm::scale(glm::mat4{1.0f}, glm::vec3(0.5f)),
+                        },
+                    .textureIndex = 1,
+                },
+        });
+        scene.addObject({
+            .meshID = "cube",
+            .ubo =
+                {
+                    .transform =
+                        {
+                            .translation = glm::translate(glm::mat4{1.0f}, glm::vec3(-10.0f, 2.f, 0.0f)),
+                            .rotation = glm::toMat4(glm::quat(glm::vec3(-(M_PI / 2), 0, 0))),
+                            .scale = glm::scale(glm::mat4{1.0f}, glm::vec3(2.0f)),
+                        },
+                    .textureIndex = 0,
+                },
+            .bOccluder = true,
+        });
     }
 
-    while (!window.shouldClose()) {
+    uploadMaterials();
+
+    while (!window.shouldClose() && (!frameLimit || frameNumber < *frameLimit) && !(benchmark && benchmark->isDone())) {
         window.setTitle(uiRessources.sWindowTitle);
         auto tp1 = std::chrono::high_resolution_clock::now();
 
-        window.pollEvent();
-        if (!bInteractWithUi) {
-            if (window.isKeyPressed(GLFW_KEY_W)) player.processKeyboard(Camera::FORWARD);
-            if (window.isKeyPressed(GLFW_KEY_S)) player.processKeyboard(Camera::BACKWARD);
-            if (window.isKeyPressed(GLFW_KEY_D)) player.processKeyboard(Camera::RIGHT);
-            if (window.isKeyPressed(GLFW_KEY_A)) player.processKeyboard(Camera::LEFT);
-            if (window.isKeyPressed(GLFW_KEY_SPACE)) player.processKeyboard(Camera::UP);
-            if (window.isKeyPressed(GLFW_KEY_LEFT_SHIFT)) player.processKeyboard(Camera::DOWN);
+        fWaitTime = 0;
+        if (creationParameters.bLowLatency) {
+            // The input is sampled once the frame slot is free, so the wait in drawFrame returns immediately
+            const auto waitBegin = std::chrono::steady_clock::now();
+            PROFILE_SCOPE("Wait frame");
+            waitTimeline(frames[currentFrame].timelineValue);
+            fWaitTime += std::chrono::duration<float>(std::chrono::steady_clock::now() - waitBegin).count();
         }
+        window.pollEvent();
+        inputTime = std::chrono::steady_clock::now();
 
         try {
-            drawImgui();
-            player.isFreeFly = uiRessources.cameraParamettersOverride.bFlyingCam;
-            player.update(fElapsedTime, -uiRessources.cameraParamettersOverride.fGravity);
+            if (!window.isHeadless()) drawImgui();
+            if (benchmark) {
+                // The path is sampled at its own timestep, there is nothing to interpolate
+                const auto camera = benchmark->getCamera();
+                player.position = camera.position;
+                player.previousPosition = camera.position;
+                player.setOrientation(camera.fYaw, camera.fPitch);
+            } else {
+                simulate(fElapsedTime);
+            }
             drawFrame();
             failedFrames = 0;
         } catch (const OutOfDateSwapchainError &oodse) {
@@ -316,59 +441,206 @@ void Application::run()
 
         if (failedFrames >= MAX_FRAME_FRAME_IN_FLIGHT) throw std::runtime_error("Multiple frames failed, exiting");
 
+        if (creationParameters.maxFrameRate > 0) {
+            PROFILE_SCOPE("Frame rate limit");
+            const auto waitBegin = std::chrono::high_resolution_clock::now();
+            std::this_thread::sleep_until(tp1 + std::chrono::duration<float>(1.0f / creationParameters.maxFrameRate));
+            fWaitTime += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - waitBegin).count();
+        }
+
         auto tp2 = std::chrono::high_resolution_clock::now();
         std::chrono::duration<float> elapsedTime(tp2 - tp1);
         fElapsedTime = elapsedTime.count();
+
+        if (benchmark) {
+            if (gpuFrameTime) benchmark->addGPUTime(*gpuFrameTime);
+            benchmark->endFrame(fElapsedTime * 1000.0f, (fElapsedTime - fWaitTime) * 1000.0f,
+                                fPresentInterval * 1000.0f);
+        }
     }
 }
 
-void Application::buildIndirectBuffers(Frame &frame)
+void Application::simulate(float fFrameTime)
 {
+    PROFILE_FUNCTION;
+    const float fTimestep = 1.0f / std::max(creationParameters.simulationRate, 1u);
+    fSimulationAccumulator = std::min(fSimulationAccumulator + fFrameTime, fTimestep * maxSimulationSteps);
+
+    for (simulationSteps = 0; fSimulationAccumulator >= fTimestep; simulationSteps++) {
+        // The velocity is reset by each step, so the held keys are applied to every step
+        if (!bInteractWithUi) {
+            if (window.isKeyPressed(GLFW_KEY_W)) player.processKeyboard(Camera::FORWARD);
+            if (window.isKeyPressed(GLFW_KEY_S)) player.processKeyboard(Camera::BACKWARD);
+            if (window.isKeyPressed(GLFW_KEY_D)) player.processKeyboard(Camera::RIGHT);
+            if (window.isKeyPressed(GLFW_KEY_A)) player.processKeyboard(Camera::LEFT);
+            if (window.isKeyPressed(GLFW_KEY_SPACE)) player.processKeyboard(Camera::UP);
+            if (window.isKeyPressed(GLFW_KEY_LEFT_SHIFT)) player.processKeyboard(Camera::DOWN);
+        }
+        player.isFreeFly = uiRessources.cameraParamettersOverride.bFlyingCam;
+        player.update(fTimestep, -uiRessources.cameraParamettersOverride.fGravity);
+        fSimulationAccumulator -= fTimestep;
+    }
+    fSimulationAlpha = fSimulationAccumulator / fTimestep;
+}
+
+void Application::buildIndirectBuffers(Frame &frame, const glm::mat4 &viewproj)
+{
+    PROFILE_FUNCTION;
+    if (uiRessources.bCpuOcclusionCulling) {
+        occlusionRasterizer.beginFrame(viewproj);
+        for (unsigned i = 0; i < scene.getNbOfObject(); i++) {
+            const auto &object = scene.getObject(i);
+            if (object.bOccluder) {
+                occlusionRasterizer.addOccluder(occluderMeshes.at(object.meshID), object.getModelMatrix());
+            }
+        }
+        occlusionRasterizer.rasterize();
+    }
+
     void *sceneData = nullptr;
+    void *instanceData = nullptr;
     allocator.mapMemory(frame.indirectBuffer.memory, &sceneData);
+    allocator.mapMemory(frame.data.instanceBuffer.memory, &instanceData);
 
     auto *buffer = (vk::DrawIndexedIndirectCommand *)sceneData;
+    auto *instances = (uint32_t *)instanceData;
+    // The GPU culling only considers the objects the CPU culling let through
+    uint32_t *objectBatch = nullptr;
+    if (creationParameters.bOcclusionCulling) {
+        void *batchData = nullptr;
+        allocator.mapMemory(frame.data.objectBatchBuffer.memory, &batchData);
+        objectBatch = (uint32_t *)batchData;
+    }
+    // One instanced command per batch. The instance buffer maps each instance to its object, in scene order, so a
+    // command only draws the objects that were not culled.
     const auto &packedDraws = scene.getDrawBatch();
-    for (uint32_t i = 0; i < packedDraws.size(); i++) {
-        const auto &mesh = loadedMeshes.at(packedDraws[i].meshId);
+    for (uint32_t b = 0; b < packedDraws.size(); b++) {
+        const auto &draw = packedDraws[b];
+        const auto &mesh = loadedMeshes.at(draw.meshId);
 
-        buffer[i].firstIndex = mesh.indicesOffset;
-        buffer[i].indexCount = mesh.indicesSize;
-        buffer[i].vertexOffset = mesh.verticiesOffset;
-        buffer[i].instanceCount = 1;
-        buffer[i].firstInstance = i;
+        buffer[b].firstIndex = mesh.indicesOffset;
+        buffer[b].indexCount = mesh.indicesSize;
+        buffer[b].vertexOffset = mesh.verticiesOffset;
+        buffer[b].instanceCount = 0;
+        buffer[b].firstInstance = draw.first;
+
+        for (uint32_t i = draw.first; i < draw.first + draw.count; i++) {
+            const auto &object = scene.getObject(i);
+            const bool bCulled = uiRessources.bCpuOcclusionCulling && !object.bOccluder &&
+                                 !occlusionRasterizer.isVisible(scene.getSpatialIndex().getFatAABB(object.proxyID));
+            if (objectBatch) objectBatch[i] = (bCulled) ? (gpuObject::culledObjectBatch) : (b);
+            if (bCulled) continue;
+            instances[draw.first + buffer[b].instanceCount++] = i;
+        }
+        frame.stats.instances += buffer[b].instanceCount;
+        frame.stats.indices += uint64_t(buffer[b].instanceCount) * buffer[b].indexCount;
+    }
+    frame.stats.triangles = frame.stats.indices / 3;
+    frame.stats.uploadedBytes += packedDraws.size() * sizeof(vk::DrawIndexedIndirectCommand) +
+                                 frame.stats.instances * sizeof(uint32_t);
+
+    if (creationParameters.bOcclusionCulling) {
+        // The instances are appended by the culling shader. Late pass instances are stored after the early ones.
+        void *lateData = nullptr;
+        allocator.mapMemory(frame.lateIndirectBuffer.memory, &lateData);
+        auto *lateBuffer = (vk::DrawIndexedIndirectCommand *)lateData;
+        for (uint32_t b = 0; b < packedDraws.size(); b++) {
+            buffer[b].instanceCount = 0;
+            lateBuffer[b] = buffer[b];
+            lateBuffer[b].firstInstance += creationParameters.maxObjects;
+        }
+        frame.stats.uploadedBytes += packedDraws.size() * sizeof(vk::DrawIndexedIndirectCommand) +
+                                     scene.getNbOfObject() * sizeof(uint32_t);
+        allocator.unmapMemory(frame.data.objectBatchBuffer.memory);
+        allocator.unmapMemory(frame.lateIndirectBuffer.memory);
     }
 
+    allocator.unmapMemory(frame.data.instanceBuffer.memory);
     allocator.unmapMemory(frame.indirectBuffer.memory);
 }
 
 void Application::drawFrame()
 try {
+    PROFILE_FUNCTION;
     auto &frame = frames[currentFrame];
     uint32_t imageIndex;
     vk::Result result;
 
-    VK_TRY(device.waitForFences(frame.inFlightFences, VK_TRUE, UINT64_MAX));
-    std::tie(result, imageIndex) =
-        device.acquireNextImageKHR(swapchain.getSwapchain(), UINT64_MAX, frame.imageAvailableSemaphore);
+    const auto waitBegin = std::chrono::steady_clock::now();
+    {
+        PROFILE_SCOPE("Wait frame");
+        waitTimeline(frame.timelineValue);
+    }
+    deferredDeletionQueue.flush(getCompletedTimelineValue());
+    updateGraphicsPipeline();
+    // The offscreen images are not acquired: each frame in flight renders to its own
+    const bool bPresent = !swapchain.isOffscreen();
+    bool bResize = false;
+    if (bPresent) {
+        std::tie(result, imageIndex) =
+            device.acquireNextImageKHR(swapchain.getSwapchain(), UINT64_MAX, frame.imageAvailableSemaphore);
+        vk_utils::vk_try(result);
+    } else {
+        imageIndex = currentFrame;
+    }
+    fWaitTime += std::chrono::duration<float>(std::chrono::steady_clock::now() - waitBegin).count();
+
+    if (creationParameters.bOcclusionCulling && frame.bCullingStatsWritten) {
+        // The late culling pass made its writes available to the host, they are visible once invalidated
+        void *statsData = nullptr;
+        allocator.invalidateAllocation(frame.data.cullingStatsBuffer.memory, 0, VK_WHOLE_SIZE);
+        allocator.mapMemory(frame.data.cullingStatsBuffer.memory, &statsData);
+        cullingStats = *(gpuObject::CullingStats *)statsData;
+        allocator.unmapMemory(frame.data.cullingStatsBuffer.memory);
+    }
 
-    vk_utils::vk_try(result);
-    device.resetFences(frame.inFlightFences);
+    // The previous submission of this frame is complete: its statistics are final
+    if (frame.timelineValue > 0) {
+        if (bPipelineStatisticsSupported) {
+            VK_TRY(device.getQueryPoolResults(frame.statisticsPool, 0, 1, sizeof(frame.stats.pipeline),
+                                              &frame.stats.pipeline, sizeof(frame.stats.pipeline),
+                                              vk::QueryResultFlagBits::e64));
+        }
+        renderStats = frame.stats;
+        if (renderStatsLog.is_open()) writeRenderStats(renderStatsLog, renderStats);
+    }
+    frame.stats = {
+        .frameNumber = frameNumber++,
+        .fFrameTime = fElapsedTime * 1000.0f,
+        .descriptorWrites = std::exchange(descriptorWriteCount, 0),
+    };
 
-    auto &cmd = commandBuffers[imageIndex];
-    cmd.reset();
+    // The previous submission of this frame is done, so its command buffers can be recycled
+    auto &cmd = frame.commandBuffer;
+    device.resetCommandPool(frame.commandPool);
+    for (auto &pool: frame.recording.commandPools) { device.resetCommandPool(pool); }
+    device.resetCommandPool(frame.recording.imguiPool);
+    frame.arena.reset();
 
     vk::Semaphore waitSemaphores[] = {frame.imageAvailableSemaphore};
     vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    vk::Semaphore signalSemaphores[] = {frame.renderFinishedSemaphore};
+    // The timeline is waited on by the next use of this frame, the binary semaphore by the presentation
+    vk::Semaphore signalSemaphores[] = {graphicsTimeline.semaphore, frame.renderFinishedSemaphore};
+    const uint64_t waitValues[] = {0};
+    const uint64_t signalValues[] = {graphicsTimeline.value + 1, 0};
+    // Without presentation, only the timeline is used
+    const uint32_t waitCount = (bPresent) ? (1) : (0);
+    const uint32_t signalCount = (bPresent) ? (2) : (1);
 
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{
+        .waitSemaphoreValueCount = waitCount,
+        .pWaitSemaphoreValues = waitValues,
+        .signalSemaphoreValueCount = signalCount,
+        .pSignalSemaphoreValues = signalValues,
+    };
     vk::SubmitInfo submitInfo{
-        .waitSemaphoreCount = 1,
+        .pNext = &timelineInfo,
+        .waitSemaphoreCount = waitCount,
         .pWaitSemaphores = waitSemaphores,
         .pWaitDstStageMask = waitStages,
         .commandBufferCount = 1,
         .pCommandBuffers = &cmd,
-        .signalSemaphoreCount = 1,
+        .signalSemaphoreCount = signalCount,
         .pSignalSemaphores = signalSemaphores,
     };
 
@@ -376,12 +648,48 @@ try {
     clearValues.at(0).color = vk::ClearColorValue{uiRessources.vClearColor};
     clearValues.at(1).depthStencil = vk::ClearDepthStencilValue{1.0f, 0};
 
-    void *objectData = nullptr;
-    allocator.mapMemory(frame.data.uniformBuffers.memory, &objectData);
-    auto *objectSSBI = (gpuObject::UniformBufferObject *)objectData;
-    for (unsigned i = 0; i < scene.getNbOfObject(); i++) { objectSSBI[i] = scene.getObject(i).ubo; }
-    allocator.unmapMemory(frame.data.uniformBuffers.memory);
-    buildIndirectBuffers(frame);
+    // Every frame in flight has its own object buffer, so a modified object has to be uploaded to each of them
+    const auto modifiedObjects = scene.update();
+    for (auto &range: pendingUploads) range.add(modifiedObjects);
+    auto &upload = pendingUploads[currentFrame];
+    upload.last = std::min<uint32_t>(upload.last, scene.getNbOfObject());
+
+    if (!upload.isEmpty()) {
+        void *objectData = nullptr;
+        allocator.mapMemory(frame.data.uniformBuffers.memory, &objectData);
+        auto *objectSSBI = (gpuObject::UniformBufferObject *)objectData;
+        jobSystem.parallelFor(upload.last - upload.first, uploadGrainSize, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = upload.first + begin; i < upload.first + end; i++) {
+                objectSSBI[i] = scene.getObject(i).ubo;
+            }
+        });
+        allocator.unmapMemory(frame.data.uniformBuffers.memory);
+        frame.stats.uploadedBytes += (upload.last - upload.first) * sizeof(gpuObject::UniformBufferObject);
+    }
+
+    // The culling uses this camera even when the one drawn is late latched
+    const auto gpuCamera = getGPUCamera();
+    *frame.data.camera = gpuCamera;
+    allocator.flushAllocation(frame.data.cameraBuffer.memory, 0, VK_WHOLE_SIZE);
+    buildIndirectBuffers(frame, gpuCamera.viewproj);
+
+    if (creationParameters.bOcclusionCulling && !upload.isEmpty()) {
+        void *boundsData = nullptr;
+        allocator.mapMemory(frame.data.boundsBuffer.memory, &boundsData);
+        auto *boundsSSBO = (gpuObject::Bounds *)boundsData;
+        jobSystem.parallelFor(upload.last - upload.first, uploadGrainSize, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = upload.first + begin; i < upload.first + end; i++) {
+                const AABB &bounds = scene.getSpatialIndex().getFatAABB(scene.getObject(i).proxyID);
+                boundsSSBO[i] = {
+                    .min = glm::vec4(bounds.min, 1.0f),
+                    .max = glm::vec4(bounds.max, 1.0f),
+                };
+            }
+        });
+        allocator.unmapMemory(frame.data.boundsBuffer.memory);
+        frame.stats.uploadedBytes += (upload.last - upload.first) * sizeof(gpuObject::Bounds);
+    }
+    upload = {};
 
     vk::RenderPassBeginInfo renderPassInfo{
         .renderPass = renderPass,
@@ -395,52 +703,239 @@ try {
         .pClearValues = clearValues.data(),
     };
 
-    auto gpuCamera = player.getGPUCameraData(uiRessources.cameraParamettersOverride.fFOV, swapchain.getAspectRatio(),
-                                             uiRessources.cameraParamettersOverride.fCloseClippingPlane,
-                                             uiRessources.cameraParamettersOverride.fFarClippingPlane);
-
-    vk::CommandBufferBeginInfo beginInfo;
+    vk::CommandBufferBeginInfo beginInfo{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+    };
+    // ImGui is not initialized without a window
+    const bool bWithImgui = !window.isHeadless();
     VK_TRY(cmd.begin(&beginInfo));
-    {
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
-        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, frame.data.objectDescriptor,
-                               nullptr);
-        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 1, texturesSet, nullptr);
-        cmd.pushConstants<Camera::GPUCameraData>(
-            pipelineLayout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, gpuCamera);
-        cmd.bindVertexBuffers(0, vertexBuffers.buffer, {0});
-        cmd.bindIndexBuffer(indicesBuffers.buffer, 0, vk::IndexType::eUint32);
-        cmd.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+    gpuFrameTime = gpuProfiler.beginFrame(cmd, currentFrame);
+    if (bPipelineStatisticsSupported) {
+        cmd.resetQueryPool(frame.statisticsPool, 0, 1);
+        cmd.beginQuery(frame.statisticsPool, 0, {});
+    }
+    if (creationParameters.bOcclusionCulling) {
+        const uint32_t objectCount = scene.getNbOfObject();
+
+        // Draw what was visible last frame, build the depth pyramid from it, then draw what was wrongly culled
         {
-            for (const auto &draw: scene.getDrawBatch()) {
-                cmd.drawIndexedIndirect(frame.indirectBuffer.buffer,
-                                        draw.first * sizeof(vk::DrawIndexedIndirectCommand), draw.count,
-                                        sizeof(vk::DrawIndexedIndirectCommand));
-            }
-            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+            GPUProfiler::Scope profile(gpuProfiler, cmd, "Early culling");
+            recordOcclusionCulling(cmd, frame, gpuCamera.viewproj, CullingPhase::Early, objectCount);
+        }
+        auto earlyCommands =
+            recordDrawCommands(frame, 0, renderPassInfo, frame.indirectBuffer.buffer, false, "Early draw");
+        cmd.beginRenderPass(renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+        cmd.executeCommands(earlyCommands);
+        cmd.endRenderPass();
+
+        {
+            GPUProfiler::Scope profile(gpuProfiler, cmd, "Depth pyramid");
+            recordDepthPyramid(cmd, frame.stats);
+        }
+        {
+            GPUProfiler::Scope profile(gpuProfiler, cmd, "Late culling");
+            recordOcclusionCulling(cmd, frame, gpuCamera.viewproj, CullingPhase::Late, objectCount);
         }
+
+        renderPassInfo.renderPass = renderPassLoad;
+        auto lateCommands =
+            recordDrawCommands(frame, 1, renderPassInfo, frame.lateIndirectBuffer.buffer, bWithImgui, "Late draw");
+        cmd.beginRenderPass(renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+        cmd.executeCommands(lateCommands);
+        cmd.endRenderPass();
+    } else {
+        auto commands =
+            recordDrawCommands(frame, 0, renderPassInfo, frame.indirectBuffer.buffer, bWithImgui, "Scene draw");
+        cmd.beginRenderPass(renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+        cmd.executeCommands(commands);
         cmd.endRenderPass();
     }
+    if (bPipelineStatisticsSupported) cmd.endQuery(frame.statisticsPool, 0);
     cmd.end();
-    graphicsQueue.submit(submitInfo, frame.inFlightFences);
-
-    vk::PresentInfoKHR presentInfo{
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = signalSemaphores,
-        .swapchainCount = 1,
-        .pSwapchains = &(swapchain.getSwapchain()),
-        .pImageIndices = &imageIndex,
-        .pResults = nullptr,
-    };
+    if (creationParameters.bLateLatchCamera) {
+        // The camera buffer may not be host coherent, so the write is flushed. The submission then makes it visible
+        // to the GPU.
+        PROFILE_SCOPE("Late latch camera");
+        window.pollEvent();
+        inputTime = std::chrono::steady_clock::now();
+        *frame.data.camera = getGPUCamera();
+        allocator.flushAllocation(frame.data.cameraBuffer.memory, 0, VK_WHOLE_SIZE);
+    }
+    graphicsQueue.submit(submitInfo);
+    const auto submitTime = std::chrono::steady_clock::now();
+    fInputLatency = std::chrono::duration<float>(submitTime - inputTime).count();
+    PROFILE_EVENT("Input to submit", inputTime, submitTime);
+    graphicsTimeline.value = signalValues[0];
+    frame.timelineValue = signalValues[0];
+    frame.bCullingStatsWritten = creationParameters.bOcclusionCulling;
 
-    vk_utils::vk_try(presentQueue.presentKHR(presentInfo));
-    currentFrame = (currentFrame + 1) % MAX_FRAME_FRAME_IN_FLIGHT;
+    if (bPresent) {
+        vk::PresentInfoKHR presentInfo{
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &frame.renderFinishedSemaphore,
+            .swapchainCount = 1,
+            .pSwapchains = &(swapchain.getSwapchain()),
+            .pImageIndices = &imageIndex,
+            .pResults = nullptr,
+        };
+        const auto presentResult = presentQueue.presentKHR(presentInfo);
+        vk_utils::vk_try(presentResult);
+        // Some platforms never report the swapchain out of date, only the resize callback tells
+        bResize = presentResult == vk::Result::eSuboptimalKHR || framebufferResized;
+    }
+    const auto presentTime = std::chrono::steady_clock::now();
+    if (lastPresentTime != std::chrono::steady_clock::time_point{}) {
+        fPresentInterval = std::chrono::duration<float>(presentTime - lastPresentTime).count();
+    }
+    lastPresentTime = presentTime;
+    currentFrame = (currentFrame + 1) % creationParameters.framesInFlight;
+    if (bResize) {
+        framebufferResized = false;
+        resizeSwapchain();
+    }
 } catch (const vk::OutOfDateKHRError &se) {
-    return recreateSwapchain();
+    framebufferResized = false;
+    return resizeSwapchain();
 } catch (const vk::Error &e) {
     throw VulkanException(e);
 }
 
+void Application::onFrameBuffersRecreated()
+{
+    // The new object, bounds and material buffers are uninitialized
+    scene.invalidate();
+    uploadMaterials();
+}
+
+void Application::uploadMaterials()
+{
+    void *objectData = nullptr;
+    for (auto &frame: frames) {
+        allocator.mapMemory(frame.data.materialBuffer.memory, &objectData);
+        auto *objectSSBI = (gpuObject::Material *)objectData;
+        for (unsigned i = 0; i < materials.size(); i++) { objectSSBI[i] = materials.at(i); }
+        allocator.unmapMemory(frame.data.materialBuffer.memory);
+    }
+}
+
+Camera::GPUCameraData Application::getGPUCamera() const
+{
+    const auto &parameters = uiRessources.cameraParamettersOverride;
+    return player.getInterpolatedCamera(fSimulationAlpha)
+        .getGPUCameraData(parameters.fFOV, swapchain.getAspectRatio(), parameters.fCloseClippingPlane,
+                          parameters.fFarClippingPlane);
+}
+
+std::pmr::vector<vk::CommandBuffer> Application::recordDrawCommands(Frame &frame, uint32_t pass,
+                                                                  const vk::RenderPassBeginInfo &renderPassInfo,
+                                                                  const vk::Buffer &indirectBuffer, bool bWithImgui,
+                                                                  std::string_view profilerScope)
+{
+    auto &recording = frame.recording;
+    const uint32_t nbOfBatch = scene.getDrawBatch().size();
+    const uint32_t nbOfJobs =
+        std::clamp<uint32_t>((nbOfBatch + minBatchesPerRecordingJob - 1) / minBatchesPerRecordingJob, 1,
+                             recording.commandPools.size());
+    const uint32_t batchesPerJob = (nbOfBatch + nbOfJobs - 1) / nbOfJobs;
+
+    vk::CommandBufferInheritanceInfo inheritanceInfo{
+        .renderPass = renderPassInfo.renderPass,
+        .subpass = 0,
+        .framebuffer = renderPassInfo.framebuffer,
+        .pipelineStatistics =
+            (bPipelineStatisticsSupported) ? (pipelineStatistics) : (vk::QueryPipelineStatisticFlags{}),
+    };
+    vk::CommandBufferBeginInfo beginInfo{
+        .flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+        .pInheritanceInfo = &inheritanceInfo,
+    };
+    const vk::Viewport viewport{
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = static_cast<float>(renderPassInfo.renderArea.extent.width),
+        .height = static_cast<float>(renderPassInfo.renderArea.extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+
+    std::pmr::vector<vk::CommandBuffer> commands(frame.arena.getResource());
+    commands.reserve(nbOfJobs + 1);
+    for (uint32_t job = 0; job < nbOfJobs; job++) {
+        commands.push_back(recording.drawCommands.at(pass * recording.commandPools.size() + job));
+    }
+    if (bWithImgui) commands.push_back(recording.imguiCommand);
+
+    // The secondary buffers are executed in order, so the scope starts in the first one and ends in the last one
+    const uint32_t drawScope = gpuProfiler.allocateScope(profilerScope);
+
+    std::pmr::vector<uint32_t> drawCalls(nbOfJobs, 0, frame.arena.getResource());
+    JobSystem::Counter counter;
+    for (uint32_t job = 0; job < nbOfJobs; job++) {
+        jobSystem.schedule(
+            [&, job] {
+                PROFILE_SCOPE("Record draw commands");
+                auto &secondary = commands.at(job);
+                const uint32_t firstBatch = std::min(job * batchesPerJob, nbOfBatch);
+                const uint32_t batchCount = std::min(batchesPerJob, nbOfBatch - firstBatch);
+
+                VK_TRY(secondary.begin(&beginInfo));
+                if (job == 0) gpuProfiler.writeBegin(secondary, drawScope);
+                // Nothing is drawn while the variant compiles for a new render pass
+                if (graphicsPipeline) {
+                    secondary.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+                    secondary.setViewport(0, viewport);
+                    secondary.setScissor(0, renderPassInfo.renderArea);
+                    if (bExtendedDynamicStateSupported) secondary.setCullModeEXT(creationParameters.cullMode);
+                    secondary.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0,
+                                                 frame.data.objectDescriptor, nullptr);
+                    secondary.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 1, texturesSet,
+                                                 nullptr);
+                    secondary.bindVertexBuffers(0, vertexBuffers.buffer, {0});
+                    secondary.bindIndexBuffer(indicesBuffers.buffer, 0, vk::IndexType::eUint32);
+
+                    const uint32_t endBatch = firstBatch + batchCount;
+                    if (creationParameters.bMultiDrawIndirect && bMultiDrawIndirectSupported) {
+                        for (uint32_t b = firstBatch; b < endBatch; b += maxDrawIndirectCount) {
+                            secondary.drawIndexedIndirect(indirectBuffer, b * sizeof(vk::DrawIndexedIndirectCommand),
+                                                          std::min(endBatch - b, maxDrawIndirectCount),
+                                                          sizeof(vk::DrawIndexedIndirectCommand));
+                            drawCalls[job] += 1;
+                        }
+                    } else {
+                        for (uint32_t b = firstBatch; b < endBatch; b++) {
+                            secondary.drawIndexedIndirect(indirectBuffer, b * sizeof(vk::DrawIndexedIndirectCommand), 1,
+                                                          sizeof(vk::DrawIndexedIndirectCommand));
+                            drawCalls[job] += 1;
+                        }
+                    }
+                }
+                if (job == nbOfJobs - 1) gpuProfiler.writeEnd(secondary, drawScope);
+                secondary.end();
+            },
+            &counter);
+    }
+    if (bWithImgui) {
+        jobSystem.schedule(
+            [&] {
+                VK_TRY(recording.imguiCommand.begin(&beginInfo));
+                {
+                    GPUProfiler::Scope profile(gpuProfiler, recording.imguiCommand, "ImGui");
+                    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), recording.imguiCommand);
+                }
+                recording.imguiCommand.end();
+            },
+            &counter);
+    }
+    jobSystem.wait(counter);
+
+    // Every job binds the pipeline and the two descriptor sets
+    frame.stats.drawCalls += std::accumulate(drawCalls.begin(), drawCalls.end(), 0u);
+    frame.stats.drawCommands += nbOfBatch;
+    frame.stats.pipelineBinds += nbOfJobs;
+    frame.stats.descriptorBinds += nbOfJobs * 2;
+    return commands;
+}
+
 void Application::drawImgui()
 {
     bool bOutOfDate = false;
@@ -455,6 +950,12 @@ void Application::drawImgui()
         vk::CullModeFlagBits::eFront,
         vk::CullModeFlagBits::eFrontAndBack,
     };
+    static const std::vector<vk::PresentModeKHR> presentModes = {
+        vk::PresentModeKHR::eFifo,
+        vk::PresentModeKHR::eFifoRelaxed,
+        vk::PresentModeKHR::eMailbox,
+        vk::PresentModeKHR::eImmediate,
+    };
 
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -473,22 +974,45 @@ void Application::drawImgui()
 
     if (ImGui::CollapsingHeader("Render")) {
         if (ImGui::Button("Recreate Swapchain")) bOutOfDate = true;
+#ifdef CPU_PROFILING
+        ImGui::SameLine();
+        if (ImGui::Button("Dump CPU trace")) PROFILE_DUMP("cpu_trace.json");
+#endif
         if (ImGui::Checkbox("Wireframe mode", &uiRessources.bWireFrameMode)) {
             creationParameters.polygonMode =
                 (uiRessources.bWireFrameMode) ? (vk::PolygonMode::eLine) : (vk::PolygonMode::eFill);
-            bOutOfDate = true;
         }
         if (ImGui::BeginCombo("##culling", vk_utils::tools::to_string(creationParameters.cullMode).c_str())) {
             for (const auto &cu: cullMode) {
                 bool is_selected = (creationParameters.cullMode == cu);
                 if (ImGui::Selectable(vk_utils::tools::to_string(cu).c_str(), is_selected)) {
                     creationParameters.cullMode = cu;
-                    bOutOfDate = true;
                 }
                 if (is_selected) { ImGui::SetItemDefaultFocus(); }
             }
             ImGui::EndCombo();
         }
+        if (ImGui::Checkbox("Occlusion culling", &creationParameters.bOcclusionCulling)) {
+            // The bounds buffers are only written while the culling is enabled
+            scene.invalidate();
+            cullingStats = {};
+            bOutOfDate = true;
+        }
+        if (creationParameters.bOcclusionCulling) {
+            ImGui::Text("Occluded objects: %u / %u", cullingStats.occludedObjects, cullingStats.testedObjects);
+            ImGui::Text("Late draws: %u", cullingStats.lateDraws);
+        }
+        if (bMultiDrawIndirectSupported) {
+            ImGui::Checkbox("Multi draw indirect", &creationParameters.bMultiDrawIndirect);
+        }
+        ImGui::Checkbox("CPU occlusion culling", &uiRessources.bCpuOcclusionCulling);
+        if (uiRessources.bCpuOcclusionCulling) {
+            const auto &stats = occlusionRasterizer.getStats();
+            ImGui::Text("Occluded objects: %u / %u", stats.occludedObjects, stats.testedObjects);
+            ImGui::Text("Rasterization: %.3f ms (%u triangles)", stats.fRasterizationTime, stats.occluderTriangles);
+            ImGui::Text("Tests: %.3f ms", stats.fTestTime);
+        }
+        ImGui::Text("Pipeline variants: %zu (%zu compiling)", pipelineVariants.size(), pipelineVariants.pending());
         if (ImGui::BeginCombo("##sample_count", vk_utils::tools::to_string(creationParameters.msaaSample).c_str())) {
             for (const auto &msaa: sampleCount) {
                 bool is_selected = (creationParameters.msaaSample == msaa);
@@ -502,7 +1026,11 @@ void Application::drawImgui()
             ImGui::EndCombo();
         }
         if (ImGui::Checkbox("Vikin Room ?", &uiRessources.bTmpObject)) {
-            if (uiRessources.bTmpObject) {
+            if (uiRessources.bTmpObject && scene.getNbOfObject() >= creationParameters.maxObjects) {
+                logger->warn("Scene") << "The object buffers are full, start with a larger -O capacity";
+                LOGGER_ENDL;
+                uiRessources.bTmpObject = false;
+            } else if (uiRessources.bTmpObject) {
                 scene.addObject({
                     .meshID = "viking_room",
                     .ubo =
@@ -516,9 +1044,43 @@ void Application::drawImgui()
                             .textureIndex = 2,
                         },
                 });
-            } else {
-                scene.removeObject(4);
+                uiRessources.tmpObjectProxy = scene.getObject(scene.getNbOfObject() - 1).proxyID;
+            } else if (uiRessources.tmpObjectProxy != AABBTree::nullNode) {
+                scene.removeObject(scene.getSpatialIndex().getUserData(uiRessources.tmpObjectProxy));
+                uiRessources.tmpObjectProxy = AABBTree::nullNode;
+            }
+        }
+    }
+    if (ImGui::CollapsingHeader("Presentation")) {
+        if (ImGui::BeginCombo("Present mode", vk::to_string(creationParameters.presentMode).c_str())) {
+            for (const auto &mode: presentModes) {
+                bool is_selected = (creationParameters.presentMode == mode);
+                if (ImGui::Selectable(vk::to_string(mode).c_str(), is_selected)) {
+                    creationParameters.presentMode = mode;
+                    bOutOfDate = true;
+                }
+                if (is_selected) { ImGui::SetItemDefaultFocus(); }
             }
+            ImGui::EndCombo();
+        }
+        ImGui::Text("In use: %s, %u images", vk::to_string(swapchain.getPresentMode()).c_str(),
+                    swapchain.nbOfImage());
+        int imageCount = creationParameters.swapchainImageCount;
+        if (ImGui::SliderInt("Swapchain images (0: auto)", &imageCount, 0, 8)) {
+            creationParameters.swapchainImageCount = imageCount;
+            bOutOfDate = true;
+        }
+        int framesInFlight = creationParameters.framesInFlight;
+        if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, MAX_FRAME_FRAME_IN_FLIGHT)) {
+            creationParameters.framesInFlight = framesInFlight;
+            bOutOfDate = true;
+        }
+        ImGui::Checkbox("Low latency", &creationParameters.bLowLatency);
+        ImGui::Checkbox("Late latch camera", &creationParameters.bLateLatchCamera);
+        ImGui::Text("Input to submit: %.2f ms", fInputLatency * 1000.0f);
+        int maxFrameRate = creationParameters.maxFrameRate;
+        if (ImGui::SliderInt("Frame rate limit (0: none)", &maxFrameRate, 0, 240)) {
+            creationParameters.maxFrameRate = maxFrameRate;
         }
     }
     if (ImGui::CollapsingHeader("Camera")) {
@@ -531,12 +1093,77 @@ void Application::drawImgui()
         ImGui::InputFloat("Close clipping plane", &uiRessources.cameraParamettersOverride.fCloseClippingPlane);
         ImGui::InputFloat("Far clipping plane", &uiRessources.cameraParamettersOverride.fFarClippingPlane);
         ImGui::Checkbox("Flying cam ?", &uiRessources.cameraParamettersOverride.bFlyingCam);
-        ImGui::SliderFloat("Gravity", &uiRessources.cameraParamettersOverride.fGravity, 0.0f, 20.f);
-        ImGui::InputFloat("Jumping Height", &player.jumpHeight);
+        ImGui::SliderFloat("Gravity", &uiRessources.cameraParamettersOverride.fGravity, 0.0f, 1200.f);
+        ImGui::InputFloat("Jump velocity", &player.jumpHeight);
+        int simulationRate = creationParameters.simulationRate;
+        if (ImGui::SliderInt("Simulation rate (Hz)", &simulationRate, 10, 240)) {
+            creationParameters.simulationRate = simulationRate;
+        }
+        ImGui::Text("Steps this frame: %u", simulationSteps);
+    }
+    if (ImGui::CollapsingHeader("Statistics")) {
+        ImGui::Text("Frame %" PRIu64, renderStats.frameNumber);
+        ImGui::Text("Draw calls: %u (%u commands)", renderStats.drawCalls, renderStats.drawCommands);
+        ImGui::Text("Instances: %u", renderStats.instances);
+        ImGui::Text("Triangles: %" PRIu64 " (%" PRIu64 " indices)", renderStats.triangles, renderStats.indices);
+        ImGui::Text("Uploaded: %.1f KiB", renderStats.uploadedBytes / 1024.0);
+        ImGui::Text("Descriptor writes: %u, binds: %u", renderStats.descriptorWrites, renderStats.descriptorBinds);
+        ImGui::Text("Pipeline binds: %u, dispatches: %u", renderStats.pipelineBinds, renderStats.dispatches);
+        if (bPipelineStatisticsSupported) {
+            const auto &pipeline = renderStats.pipeline;
+            ImGui::Separator();
+            ImGui::Text("Input assembly primitives: %" PRIu64, pipeline.inputAssemblyPrimitives);
+            ImGui::Text("Vertex shader invocations: %" PRIu64, pipeline.vertexShaderInvocations);
+            ImGui::Text("Clipping: %" PRIu64 " in, %" PRIu64 " out", pipeline.clippingInvocations,
+                        pipeline.clippingPrimitives);
+            ImGui::Text("Fragment shader invocations: %" PRIu64, pipeline.fragmentShaderInvocations);
+        }
+        bool bLogStats = renderStatsLog.is_open();
+        if (ImGui::Checkbox("Log to render_stats.csv", &bLogStats)) {
+            if (bLogStats) {
+                renderStatsLog.open("render_stats.csv", std::ios::trunc);
+                writeRenderStatsHeader(renderStatsLog);
+            } else {
+                renderStatsLog.close();
+            }
+        }
     }
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
                 ImGui::GetIO().Framerate);
     ImGui::End();
+
+    if (gpuProfiler.isSupported()) {
+        ImGui::Begin("GPU profiler");
+        ImGui::Text("Last %zu frames, in ms", GPUProfiler::historySize);
+        if (ImGui::BeginTable("##gpu_profiler", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            for (const char *header: {"Scope", "Avg", "Min", "Max", "P50", "P95", "P99"}) {
+                ImGui::TableSetupColumn(header);
+            }
+            ImGui::TableHeadersRow();
+            for (const auto &scope: gpuProfiler.getStats()) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(scope.name.c_str());
+                const auto &history = scope.history;
+                for (float fValue: {history.fAverage, history.fMin, history.fMax, history.fMedian,
+                                    history.fPercentile95, history.fPercentile99}) {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", fValue);
+                }
+            }
+            ImGui::EndTable();
+        }
+        try {
+            if (ImGui::Button("Export CSV")) gpuProfiler.exportCSV("gpu_profile.csv");
+            ImGui::SameLine();
+            if (ImGui::Button("Export JSON")) gpuProfiler.exportJSON("gpu_profile.json");
+        } catch (const std::exception &e) {
+            // Only the export is lost
+            logger->warn("GPUProfiler") << "Failed to export the profile: " << e.what();
+            LOGGER_ENDL;
+        }
+        ImGui::End();
+    }
     ImGui::Render();
 
     if (bOutOfDate) throw OutOfDateSwapchainError();
@@ -0,0 +1,127 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+Benchmark::Benchmark(const std::filesystem::path &path): pathFile(path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("failed to open benchmark path: " + path.string());
+
+    std::string line;
+    for (unsigned lineNumber = 1; std::getline(file, line); lineNumber++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        std::string statement;
+        if (!(stream >> statement)) continue;
+
+        const std::string location = path.string() + ":" + std::to_string(lineNumber) + ": ";
+        if (statement == "timestep") {
+            if (!(stream >> fTimestep) || fTimestep <= 0.0f) throw std::runtime_error(location + "invalid timestep");
+        } else if (statement == "warmup") {
+            if (!(stream >> warmupFrames)) throw std::runtime_error(location + "invalid warmup");
+        } else if (statement == "key") {
+            Keyframe key;
+            if (!(stream >> key.fTime >> key.position.x >> key.position.y >> key.position.z >> key.fYaw >>
+                  key.fPitch)) {
+                throw std::runtime_error(location + "invalid key");
+            }
+            if (!keyframes.empty() && key.fTime < keyframes.back().fTime) {
+                throw std::runtime_error(location + "keys must be sorted by time");
+            }
+            keyframes.push_back(key);
+        } else {
+            throw std::runtime_error(location + "unknown statement " + statement);
+        }
+    }
+    if (keyframes.empty()) throw std::runtime_error(path.string() + ": benchmark path has no key");
+}
+
+Benchmark::~Benchmark() {}
+
+Benchmark::Keyframe Benchmark::getCamera() const
+{
+    // The warmup frames stay at the start of the path
+    const float fTime = (isWarmingUp()) ? (0.0f) : ((frameIndex - warmupFrames) * fTimestep);
+
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), fTime,
+                                 [](float fValue, const Keyframe &key) { return fValue < key.fTime; });
+    if (next == keyframes.begin()) return keyframes.front();
+    if (next == keyframes.end()) return keyframes.back();
+
+    const auto &previous = *(next - 1);
+    const float fRatio = (fTime - previous.fTime) / (next->fTime - previous.fTime);
+    return {
+        .fTime = fTime,
+        .position = glm::mix(previous.position, next->position, fRatio),
+        .fYaw = glm::mix(previous.fYaw, next->fYaw, fRatio),
+        .fPitch = glm::mix(previous.fPitch, next->fPitch, fRatio),
+    };
+}
+
+bool Benchmark::isDone() const noexcept
+{
+    return !isWarmingUp() && (frameIndex - warmupFrames) * fTimestep > keyframes.back().fTime;
+}
+
+void Benchmark::endFrame(float fFrameTime, float fCpuTime, float fPresentInterval)
+{
+    if (!isWarmingUp()) {
+        frameTimes.push_back(fFrameTime);
+        cpuTimes.push_back(fCpuTime);
+        presentIntervals.push_back(fPresentInterval);
+    }
+    frameIndex++;
+}
+
+void Benchmark::addGPUTime(float fGpuTime)
+{
+    if (!isWarmingUp()) gpuTimes.push_back(fGpuTime);
+}
+
+Benchmark::Summary Benchmark::summarize(const std::vector<float> &samples)
+{
+    if (samples.empty()) return {};
+
+    std::vector<float> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](float fRatio) { return sorted[static_cast<size_t>(fRatio * (sorted.size() - 1))]; };
+    return {
+        .fMean = std::accumulate(sorted.begin(), sorted.end(), 0.0f) / sorted.size(),
+        .fMedian = percentile(0.50f),
+        .fPercentile95 = percentile(0.95f),
+        .fPercentile99 = percentile(0.99f),
+        .fMax = sorted.back(),
+    };
+}
+
+void Benchmark::writeReport(const std::filesystem::path &path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("failed to open benchmark report: " + path.string());
+
+    auto writeMetric = [&](const char *name, const std::vector<float> &samples, bool bLast) {
+        const Summary summary = summarize(samples);
+        file << "  \"" << name << "\": {\"mean\": " << summary.fMean << ", \"p50\": " << summary.fMedian
+             << ", \"p95\": " << summary.fPercentile95 << ", \"p99\": " << summary.fPercentile99
+             << ", \"max\": " << summary.fMax << ", \"samples\": [";
+        for (size_t i = 0; i < samples.size(); i++) { file << ((i > 0) ? (", ") : ("")) << samples[i]; }
+        file << "]}" << ((bLast) ? ("") : (",")) << "\n";
+    };
+
+    file << "{\n";
+    file << "  \"path\": \"" << pathFile.generic_string() << "\",\n";
+    file << "  \"timestep\": " << fTimestep << ",\n";
+    file << "  \"warmup_frames\": " << warmupFrames << ",\n";
+    file << "  \"frames\": " << frameTimes.size() << ",\n";
+    writeMetric("frame_time_ms", frameTimes, false);
+    writeMetric("cpu_time_ms", cpuTimes, false);
+    writeMetric("gpu_time_ms", gpuTimes, false);
+    writeMetric("present_interval_ms", presentIntervals, true);
+    file << "}\n";
+}
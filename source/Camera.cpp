@@ -30,6 +30,13 @@ Camera::GPUCameraData Camera::getGPUCameraData(float fFOV, float fAspectRatio, f
     return data;
 }
 
+void Camera::setOrientation(float newYaw, float newPitch)
+{
+    yaw = newYaw;
+    pitch = newPitch;
+    updateCameraVectors();
+}
+
 void Camera::updateCameraVectors()
 {
     glm::vec3 tmpFront;
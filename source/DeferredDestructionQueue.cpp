@@ -0,0 +1,110 @@
+#include "DeferredDestructionQueue.hpp"
+
+#include <Logger.hpp>
+#include <algorithm>
+#include <utility>
+
+template <typename Handle>
+static Handle toHandle(uint64_t handle)
+{
+    return Handle((typename Handle::CType)(handle));
+}
+
+DeferredDestructionQueue::DeferredDestructionQueue() {}
+
+DeferredDestructionQueue::~DeferredDestructionQueue()
+{
+    if (count > 0) {
+        logger->warn("DeferredDestructionQueue") << count << " resources were never destroyed";
+        LOGGER_ENDL;
+    }
+}
+
+void DeferredDestructionQueue::init(vk::Device &newDevice, vma::Allocator &newAllocator, size_t capacity)
+{
+    device = newDevice;
+    allocator = newAllocator;
+    entries.resize(std::max<size_t>(capacity, 1));
+    first = 0;
+    count = 0;
+}
+
+void DeferredDestructionQueue::pushEntry(const Entry &entry)
+{
+    if (count == entries.size()) {
+        // Unroll the ring in a buffer twice as large
+        std::vector<Entry> grown(std::max(entries.size() * 2, defaultCapacity));
+        for (size_t i = 0; i < count; i++) { grown[i] = at(i); }
+        entries = std::move(grown);
+        first = 0;
+    }
+    at(count++) = entry;
+}
+
+void DeferredDestructionQueue::moveTo(DeferredDestructionQueue &other, uint64_t value)
+{
+    for (size_t i = 0; i < count; i++) {
+        auto entry = at(i);
+        entry.value = value;
+        other.pushEntry(entry);
+    }
+    first = 0;
+    count = 0;
+}
+
+void DeferredDestructionQueue::flush(uint64_t completedValue)
+{
+    while (count > 0 && at(0).value <= completedValue) {
+        destroy(at(0));
+        first = (first + 1) % entries.size();
+        count--;
+    }
+}
+
+void DeferredDestructionQueue::flush()
+{
+    for (size_t i = 0; i < count; i++) { destroy(at(i)); }
+    first = 0;
+    count = 0;
+}
+
+void DeferredDestructionQueue::destroy(const Entry &entry)
+{
+    switch (entry.type) {
+        case vk::ObjectType::eBuffer: {
+            const auto buffer = toHandle<vk::Buffer>(entry.handle);
+            if (entry.allocation) {
+                allocator.destroyBuffer(buffer, entry.allocation);
+            } else {
+                device.destroy(buffer);
+            }
+        } break;
+        case vk::ObjectType::eImage: {
+            const auto image = toHandle<vk::Image>(entry.handle);
+            if (entry.allocation) {
+                allocator.destroyImage(image, entry.allocation);
+            } else {
+                device.destroy(image);
+            }
+        } break;
+        case vk::ObjectType::eImageView: device.destroy(toHandle<vk::ImageView>(entry.handle)); break;
+        case vk::ObjectType::eSampler: device.destroy(toHandle<vk::Sampler>(entry.handle)); break;
+        case vk::ObjectType::eFramebuffer: device.destroy(toHandle<vk::Framebuffer>(entry.handle)); break;
+        case vk::ObjectType::eRenderPass: device.destroy(toHandle<vk::RenderPass>(entry.handle)); break;
+        case vk::ObjectType::ePipeline: device.destroy(toHandle<vk::Pipeline>(entry.handle)); break;
+        case vk::ObjectType::ePipelineLayout: device.destroy(toHandle<vk::PipelineLayout>(entry.handle)); break;
+        case vk::ObjectType::eDescriptorPool: device.destroy(toHandle<vk::DescriptorPool>(entry.handle)); break;
+        case vk::ObjectType::eDescriptorSetLayout:
+            device.destroy(toHandle<vk::DescriptorSetLayout>(entry.handle));
+            break;
+        case vk::ObjectType::eShaderModule: device.destroy(toHandle<vk::ShaderModule>(entry.handle)); break;
+        case vk::ObjectType::eCommandPool: device.destroy(toHandle<vk::CommandPool>(entry.handle)); break;
+        case vk::ObjectType::eSemaphore: device.destroy(toHandle<vk::Semaphore>(entry.handle)); break;
+        case vk::ObjectType::eQueryPool: device.destroy(toHandle<vk::QueryPool>(entry.handle)); break;
+        case vk::ObjectType::eSwapchainKHR: device.destroy(toHandle<vk::SwapchainKHR>(entry.handle)); break;
+        default:
+            logger->err("DeferredDestructionQueue") << "unsupported handle type " << vk::to_string(entry.type);
+            LOGGER_ENDL;
+            break;
+    }
+}
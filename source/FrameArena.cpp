@@ -0,0 +1,41 @@
+#include "FrameArena.hpp"
+
+#include <bit>
+
+FrameArena::FrameArena(size_t initialCapacity): capacity(initialCapacity), buffer(new std::byte[initialCapacity])
+{
+    arena.emplace(buffer.get(), capacity, &overflow);
+}
+
+FrameArena::~FrameArena() {}
+
+void FrameArena::reset()
+{
+    if (overflow.allocated == 0) {
+        arena->release();
+        return;
+    }
+
+    // The buffer fits the last frame from now on
+    capacity = std::bit_ceil(capacity + overflow.allocated);
+    arena.reset();
+    overflow.allocated = 0;
+    buffer.reset(new std::byte[capacity]);
+    arena.emplace(buffer.get(), capacity, &overflow);
+}
+
+void *FrameArena::OverflowResource::do_allocate(size_t bytes, size_t alignment)
+{
+    allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void FrameArena::OverflowResource::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool FrameArena::OverflowResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
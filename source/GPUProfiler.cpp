@@ -0,0 +1,148 @@
+#include "GPUProfiler.hpp"
+
+#include <Logger.hpp>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+GPUProfiler::Scope::Scope(GPUProfiler &profiler, vk::CommandBuffer &cmd, std::string_view name)
+    : profiler(profiler), cmd(cmd), scope(profiler.allocateScope(name))
+{
+    profiler.writeBegin(cmd, scope);
+}
+
+GPUProfiler::Scope::~Scope() { profiler.writeEnd(cmd, scope); }
+
+GPUProfiler::GPUProfiler() {}
+
+GPUProfiler::~GPUProfiler() {}
+
+void GPUProfiler::init(vk::Device &dev, vk::PhysicalDevice &physicalDevice, uint32_t queueFamily, uint32_t nbOfFrames)
+{
+    device = dev;
+    const auto validBits = physicalDevice.getQueueFamilyProperties().at(queueFamily).timestampValidBits;
+    const auto &limits = physicalDevice.getProperties().limits;
+    bSupported = validBits > 0 && limits.timestampPeriod > 0.0f;
+    if (!bSupported) {
+        logger->warn("GPUProfiler") << "Timestamps are not supported by the graphics queue, GPU profiling disabled";
+        LOGGER_ENDL;
+        return;
+    }
+    fTimestampPeriod = limits.timestampPeriod;
+    timestampMask = (validBits >= 64) ? (~uint64_t(0)) : ((uint64_t(1) << validBits) - 1);
+
+    vk::QueryPoolCreateInfo poolInfo{
+        .queryType = vk::QueryType::eTimestamp,
+        .queryCount = maxScopes * 2,
+    };
+    frames.resize(nbOfFrames);
+    for (auto &frame: frames) { frame.pool = device.createQueryPool(poolInfo); }
+    sortedSamples.reserve(historySize);
+}
+
+void GPUProfiler::destroy()
+{
+    for (auto &frame: frames) { device.destroy(frame.pool); }
+    frames.clear();
+}
+
+std::optional<float> GPUProfiler::beginFrame(vk::CommandBuffer &cmd, uint32_t frameIndex)
+{
+    if (!bSupported) return std::nullopt;
+
+    std::lock_guard lock(scopeMutex);
+    currentFrame = frameIndex;
+    auto &frame = frames.at(currentFrame);
+    std::optional<float> frameTime;
+    if (!frame.names.empty()) {
+        std::array<uint64_t, maxScopes * 2> timestamps;
+        const uint32_t queryCount = frame.names.size() * 2;
+        const auto result =
+            device.getQueryPoolResults(frame.pool, 0, queryCount, queryCount * sizeof(uint64_t), timestamps.data(),
+                                       sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result == vk::Result::eSuccess) {
+            // From the first scope begin to the last scope end
+            uint64_t first = timestamps[0];
+            uint64_t last = timestamps[1];
+            for (uint32_t i = 0; i < frame.names.size(); i++) {
+                const uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+                addSample(frame.names[i], ticks * fTimestampPeriod / 1e6f);
+                first = std::min(first, timestamps[i * 2]);
+                last = std::max(last, timestamps[i * 2 + 1]);
+            }
+            frameTime = ((last - first) & timestampMask) * fTimestampPeriod / 1e6f;
+        }
+        frame.names.clear();
+    }
+    cmd.resetQueryPool(frame.pool, 0, maxScopes * 2);
+    return frameTime;
+}
+
+uint32_t GPUProfiler::allocateScope(std::string_view name)
+{
+    if (!bSupported) return invalidScope;
+
+    std::lock_guard lock(scopeMutex);
+    auto &names = frames.at(currentFrame).names;
+    if (names.size() >= maxScopes) return invalidScope;
+    names.emplace_back(name);
+    return names.size() - 1;
+}
+
+void GPUProfiler::writeBegin(vk::CommandBuffer &cmd, uint32_t scope)
+{
+    if (scope == invalidScope) return;
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frames.at(currentFrame).pool, scope * 2);
+}
+
+void GPUProfiler::writeEnd(vk::CommandBuffer &cmd, uint32_t scope)
+{
+    if (scope == invalidScope) return;
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frames.at(currentFrame).pool, scope * 2 + 1);
+}
+
+void GPUProfiler::addSample(const std::string &name, float fMilliseconds)
+{
+    auto iter = std::find_if(stats.begin(), stats.end(), [&](const auto &scope) { return scope.name == name; });
+    if (iter == stats.end()) {
+        stats.push_back({.name = name});
+        iter = stats.end() - 1;
+    }
+
+    iter->history.add(fMilliseconds, sortedSamples);
+}
+
+void GPUProfiler::exportCSV(const std::filesystem::path &path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("failed to open profiler export: " + path.string());
+
+    file << "scope,average_ms,min_ms,max_ms,median_ms,p95_ms,p99_ms,samples_ms\n";
+    for (const auto &scope: stats) {
+        const auto &history = scope.history;
+        file << scope.name << "," << history.fAverage << "," << history.fMin << "," << history.fMax << ","
+             << history.fMedian << "," << history.fPercentile95 << "," << history.fPercentile99 << ",";
+        for (size_t i = 0; i < history.count; i++) { file << ((i > 0) ? (" ") : ("")) << history.getSample(i); }
+        file << "\n";
+    }
+}
+
+void GPUProfiler::exportJSON(const std::filesystem::path &path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("failed to open profiler export: " + path.string());
+
+    file << "{\n  \"scopes\": [";
+    for (size_t s = 0; s < stats.size(); s++) {
+        const auto &history = stats[s].history;
+        file << ((s > 0) ? (",") : ("")) << "\n    {\"name\": \"" << stats[s].name << "\""
+             << ", \"average_ms\": " << history.fAverage << ", \"min_ms\": " << history.fMin
+             << ", \"max_ms\": " << history.fMax << ", \"median_ms\": " << history.fMedian
+             << ", \"p95_ms\": " << history.fPercentile95 << ", \"p99_ms\": " << history.fPercentile99
+             << ", \"samples_ms\": [";
+        for (size_t i = 0; i < history.count; i++) { file << ((i > 0) ? (", ") : ("")) << history.getSample(i); }
+        file << "]}";
+    }
+    file << "\n  ]\n}\n";
+}
@@ -0,0 +1,230 @@
+#include "JobSystem.hpp"
+
+#include <Logger.hpp>
+#include <utility>
+
+// Index of the current thread in the job system it belongs to
+static thread_local const JobSystem *currentSystem = nullptr;
+static thread_local unsigned currentIndex = 0;
+
+bool JobSystem::WorkQueue::push(Task *task) noexcept
+{
+    const int64_t b = bottom.load(std::memory_order_relaxed);
+    const int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= capacity) return false;
+
+    tasks[b % capacity].store(task, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Task *JobSystem::WorkQueue::pop() noexcept
+{
+    const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Task *task = tasks[b % capacity].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last task, race against the thieves
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+JobSystem::Task *JobSystem::WorkQueue::steal() noexcept
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    Task *task = tasks[t % capacity].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+    return task;
+}
+
+JobSystem::Task *JobSystem::TaskPool::allocate() noexcept
+{
+    // The tasks are mostly released in the order they were allocated, so the next one is usually free
+    for (size_t i = 0; i < capacity; i++) {
+        Task &task = tasks[(cursor + i) % capacity];
+        if (!task.bFree.load(std::memory_order_acquire)) continue;
+
+        cursor = (cursor + i + 1) % capacity;
+        task.bFree.store(false, std::memory_order_relaxed);
+        task.bPooled = true;
+        return &task;
+    }
+    return nullptr;
+}
+
+JobSystem::JobSystem(unsigned nbOfThreads)
+{
+    if (nbOfThreads == 0) nbOfThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    queues.resize(nbOfThreads);
+    for (auto &queue: queues) { queue = std::make_unique<WorkQueue>(); }
+    pools.resize(nbOfThreads);
+    for (auto &pool: pools) { pool = std::make_unique<TaskPool>(); }
+
+    currentSystem = this;
+    currentIndex = 0;
+    workers.reserve(nbOfThreads - 1);
+    for (unsigned i = 1; i < nbOfThreads; i++) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(sleepMutex);
+        bStop = true;
+    }
+    sleepCondition.notify_all();
+    workers.clear();
+
+    // Jobs nobody waited on
+    for (auto &queue: queues) {
+        while (Task *task = queue->steal()) { releaseTask(task); }
+    }
+    while (Task *task = injectionHead) {
+        injectionHead = task->next;
+        releaseTask(task);
+    }
+    if (currentSystem == this) currentSystem = nullptr;
+}
+
+void JobSystem::wait(Counter &counter)
+{
+    while (!counter.isDone()) {
+        if (Task *task = findTask()) {
+            execute(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    // Wait for the last job to release the counter
+    std::lock_guard lock(counter.mutex);
+    if (counter.exception) std::rethrow_exception(std::exchange(counter.exception, nullptr));
+}
+
+JobSystem::Task *JobSystem::allocateTask()
+{
+    if (currentSystem == this) {
+        if (Task *task = pools[currentIndex]->allocate()) return task;
+    }
+    return new Task;
+}
+
+void JobSystem::releaseTask(Task *task) noexcept
+{
+    task->destroy(task->storage);
+    if (task->bPooled) {
+        task->bFree.store(true, std::memory_order_release);
+    } else {
+        delete task;
+    }
+}
+
+void JobSystem::push(Task *task)
+{
+    pendingJobs.fetch_add(1, std::memory_order_release);
+    if (currentSystem != this || !queues[currentIndex]->push(task)) {
+        std::lock_guard lock(injectionMutex);
+        task->next = nullptr;
+        if (injectionTail) {
+            injectionTail->next = task;
+        } else {
+            injectionHead = task;
+        }
+        injectionTail = task;
+    }
+    {
+        std::lock_guard lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+JobSystem::Task *JobSystem::findTask()
+{
+    Task *task = nullptr;
+    const bool bIsMember = (currentSystem == this);
+
+    if (bIsMember) task = queues[currentIndex]->pop();
+    if (!task) {
+        std::lock_guard lock(injectionMutex);
+        if (injectionHead) {
+            task = injectionHead;
+            injectionHead = task->next;
+            if (!injectionHead) injectionTail = nullptr;
+        }
+    }
+    // Start with the next queue, so the thieves do not all target the same one
+    for (unsigned i = 1; !task && i <= queues.size(); i++) {
+        const unsigned victim = ((bIsMember) ? (currentIndex) : (0)) + i;
+        task = queues[victim % queues.size()]->steal();
+    }
+    if (task) pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+void JobSystem::execute(Task *task)
+{
+    Counter *counter = task->counter;
+    try {
+        task->run(task->storage);
+    } catch (...) {
+        if (counter) {
+            std::lock_guard lock(counter->mutex);
+            if (!counter->exception) counter->exception = std::current_exception();
+        } else {
+            logger->err("JOB_SYSTEM") << "Uncaught exception in a job";
+            LOGGER_ENDL;
+        }
+    }
+    // The captures may refer to the waiting thread, they are destroyed before it is released
+    releaseTask(task);
+    if (counter) finish(*counter);
+}
+
+void JobSystem::finish(Counter &counter)
+{
+    Task *continuations = nullptr;
+    {
+        std::lock_guard lock(counter.mutex);
+        if (counter.value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            continuations = std::exchange(counter.continuations, nullptr);
+        }
+    }
+    while (Task *task = continuations) {
+        continuations = task->next;
+        push(task);
+    }
+}
+
+void JobSystem::workerLoop(unsigned index)
+{
+    currentSystem = this;
+    currentIndex = index;
+
+    while (true) {
+        if (Task *task = findTask()) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock lock(sleepMutex);
+        sleepCondition.wait(lock, [this] { return bStop || pendingJobs.load(std::memory_order_acquire) > 0; });
+        if (bStop) return;
+    }
+}
@@ -0,0 +1,254 @@
+#include "OcclusionRasterizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define OCCLUSION_RASTERIZER_SSE2
+#endif
+
+// Triangles crossing the near plane are dropped instead of clipped, so they never occlude anything
+static constexpr float minW = 1e-4f;
+static constexpr float minArea = 1e-6f;
+
+static glm::vec3 edgeEquation(const glm::vec2 &a, const glm::vec2 &b)
+{
+    return {
+        a.y - b.y,
+        b.x - a.x,
+        (b.y - a.y) * a.x - (b.x - a.x) * a.y,
+    };
+}
+
+#ifndef OCCLUSION_RASTERIZER_SSE2
+static float evaluate(const glm::vec3 &equation, float x, float y)
+{
+    return equation.x * x + equation.y * y + equation.z;
+}
+#endif
+
+OcclusionRasterizer::OcclusionRasterizer(JobSystem &jobSystem, uint32_t width, uint32_t height): jobSystem(jobSystem)
+{
+    resize(width, height);
+}
+
+OcclusionRasterizer::~OcclusionRasterizer() {}
+
+void OcclusionRasterizer::resize(uint32_t newWidth, uint32_t newHeight)
+{
+    // Rows are processed 4 pixels at a time
+    width = std::max((newWidth + 3u) & ~3u, 4u);
+    height = std::max(newHeight, 1u);
+    tilesX = (width + tileWidth - 1) / tileWidth;
+    tilesY = (height + tileHeight - 1) / tileHeight;
+    depthBuffer.assign(width * height, 1.0f);
+    tileBins.resize(tilesX * tilesY);
+}
+
+void OcclusionRasterizer::beginFrame(const glm::mat4 &newViewproj)
+{
+    frameStart = std::chrono::high_resolution_clock::now();
+    viewproj = newViewproj;
+    triangles.clear();
+    for (auto &bin: tileBins) { bin.clear(); }
+    stats = {};
+}
+
+void OcclusionRasterizer::addOccluder(const Mesh &mesh, const glm::mat4 &model)
+{
+    const glm::mat4 transform = viewproj * model;
+    clipPositions.resize(mesh.positions.size());
+    std::transform(mesh.positions.begin(), mesh.positions.end(), clipPositions.begin(),
+                   [&](const glm::vec3 &p) { return transform * glm::vec4(p, 1.0f); });
+
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        std::array<glm::vec3, 3> screen;
+        bool bBehind = false;
+        for (unsigned v = 0; v < 3; v++) {
+            const glm::vec4 &c = clipPositions[mesh.indices[i + v]];
+            if (c.w < minW) {
+                bBehind = true;
+                break;
+            }
+            const glm::vec3 ndc = glm::vec3(c) / c.w;
+            screen[v] = {
+                (ndc.x * 0.5f + 0.5f) * width,
+                (ndc.y * 0.5f + 0.5f) * height,
+                ndc.z,
+            };
+        }
+        if (bBehind) continue;
+
+        glm::vec2 v0(screen[0]), v1(screen[1]), v2(screen[2]);
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::abs(area) < minArea) continue;
+        // Both windings are accepted, flip the triangle so the edge functions are positive inside
+        if (area < 0.0f) {
+            std::swap(v1, v2);
+            std::swap(screen[1], screen[2]);
+            area = -area;
+        }
+
+        Triangle tri{
+            .edges = {edgeEquation(v1, v2), edgeEquation(v2, v0), edgeEquation(v0, v1)},
+            .zPlane = glm::vec3(0.0f),
+            .minX = std::max(static_cast<int32_t>(std::floor(std::min({v0.x, v1.x, v2.x}))), 0),
+            .minY = std::max(static_cast<int32_t>(std::floor(std::min({v0.y, v1.y, v2.y}))), 0),
+            .maxX = std::min(static_cast<int32_t>(std::ceil(std::max({v0.x, v1.x, v2.x}))),
+                             static_cast<int32_t>(width) - 1),
+            .maxY = std::min(static_cast<int32_t>(std::ceil(std::max({v0.y, v1.y, v2.y}))),
+                             static_cast<int32_t>(height) - 1),
+        };
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY) continue;
+
+        // The edge functions are the (scaled) barycentric coordinates of each vertex
+        tri.zPlane = (tri.edges[0] * screen[0].z + tri.edges[1] * screen[1].z + tri.edges[2] * screen[2].z) / area;
+
+        const uint32_t index = triangles.size();
+        triangles.push_back(tri);
+        for (uint32_t ty = tri.minY / tileHeight; ty <= tri.maxY / tileHeight; ty++) {
+            for (uint32_t tx = tri.minX / tileWidth; tx <= tri.maxX / tileWidth; tx++) {
+                tileBins[ty * tilesX + tx].push_back(index);
+            }
+        }
+    }
+    stats.occluderTriangles = triangles.size();
+}
+
+void OcclusionRasterizer::rasterize()
+{
+    std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+    if (!triangles.empty()) {
+        jobSystem.parallelFor(tileBins.size(), 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t tile = begin; tile < end; tile++) { rasterizeTile(tile); }
+        });
+    }
+
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - frameStart;
+    stats.fRasterizationTime = elapsed.count();
+}
+
+void OcclusionRasterizer::rasterizeTile(uint32_t tileIndex)
+{
+    const int32_t tileMinX = (tileIndex % tilesX) * tileWidth;
+    const int32_t tileMinY = (tileIndex / tilesX) * tileHeight;
+    const int32_t tileMaxX = std::min<int32_t>(tileMinX + tileWidth, width) - 1;
+    const int32_t tileMaxY = std::min<int32_t>(tileMinY + tileHeight, height) - 1;
+
+    for (const uint32_t index: tileBins[tileIndex]) {
+        rasterizeTriangle(triangles[index], tileMinX, tileMinY, tileMaxX, tileMaxY);
+    }
+}
+
+void OcclusionRasterizer::rasterizeTriangle(const Triangle &tri, int32_t tileMinX, int32_t tileMinY,
+                                            int32_t tileMaxX, int32_t tileMaxY)
+{
+    // Tiles are 4 pixels aligned, so aligning the start keeps every group of 4 pixels inside the tile
+    const int32_t minX = std::max(tri.minX, tileMinX) & ~3;
+    const int32_t maxX = std::min(tri.maxX, tileMaxX);
+    const int32_t minY = std::max(tri.minY, tileMinY);
+    const int32_t maxY = std::min(tri.maxY, tileMaxY);
+
+#ifdef OCCLUSION_RASTERIZER_SSE2
+    const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 edgeA[3], edgeStep[3];
+    for (unsigned e = 0; e < 3; e++) {
+        edgeA[e] = _mm_set1_ps(tri.edges[e].x);
+        edgeStep[e] = _mm_set1_ps(tri.edges[e].x * 4.0f);
+    }
+    const __m128 zA = _mm_set1_ps(tri.zPlane.x);
+    const __m128 zStep = _mm_set1_ps(tri.zPlane.x * 4.0f);
+
+    for (int32_t y = minY; y <= maxY; y++) {
+        const float py = y + 0.5f;
+        const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(minX)), laneOffset);
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA[0], px), _mm_set1_ps(tri.edges[0].y * py + tri.edges[0].z));
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA[1], px), _mm_set1_ps(tri.edges[1].y * py + tri.edges[1].z));
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA[2], px), _mm_set1_ps(tri.edges[2].y * py + tri.edges[2].z));
+        __m128 z = _mm_add_ps(_mm_mul_ps(zA, px), _mm_set1_ps(tri.zPlane.y * py + tri.zPlane.z));
+
+        float *row = depthBuffer.data() + y * width;
+        for (int32_t x = minX; x <= maxX; x += 4) {
+            const __m128 inside =
+                _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) != 0) {
+                const __m128 depth = _mm_loadu_ps(row + x);
+                const __m128 closest = _mm_min_ps(depth, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, depth)));
+            }
+            e0 = _mm_add_ps(e0, edgeStep[0]);
+            e1 = _mm_add_ps(e1, edgeStep[1]);
+            e2 = _mm_add_ps(e2, edgeStep[2]);
+            z = _mm_add_ps(z, zStep);
+        }
+    }
+#else
+    for (int32_t y = minY; y <= maxY; y++) {
+        const float py = y + 0.5f;
+        float *row = depthBuffer.data() + y * width;
+        for (int32_t x = minX; x <= maxX; x++) {
+            const float px = x + 0.5f;
+            if (evaluate(tri.edges[0], px, py) < 0.0f || evaluate(tri.edges[1], px, py) < 0.0f ||
+                evaluate(tri.edges[2], px, py) < 0.0f)
+                continue;
+            row[x] = std::min(row[x], evaluate(tri.zPlane, px, py));
+        }
+    }
+#endif
+}
+
+bool OcclusionRasterizer::isVisible(const AABB &box)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    const auto result = [&] {
+        glm::vec2 rectMin(std::numeric_limits<float>::max());
+        glm::vec2 rectMax(std::numeric_limits<float>::lowest());
+        float closestDepth = 1.0f;
+        for (unsigned i = 0; i < 8; i++) {
+            const glm::vec4 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y,
+                                   (i & 4) ? box.max.z : box.min.z, 1.0f);
+            const glm::vec4 clip = viewproj * corner;
+            // Crossing the near plane, assume it is visible
+            if (clip.w < minW) return true;
+
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            const glm::vec2 screen((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height);
+            rectMin = glm::min(rectMin, screen);
+            rectMax = glm::max(rectMax, screen);
+            closestDepth = std::min(closestDepth, ndc.z);
+        }
+
+        // Outside of the screen
+        if (rectMax.x < 0.0f || rectMax.y < 0.0f || rectMin.x >= width || rectMin.y >= height) return false;
+
+        const int32_t minX = std::max(static_cast<int32_t>(std::floor(rectMin.x)), 0);
+        const int32_t minY = std::max(static_cast<int32_t>(std::floor(rectMin.y)), 0);
+        const int32_t maxX = std::min(static_cast<int32_t>(rectMax.x), static_cast<int32_t>(width) - 1);
+        const int32_t maxY = std::min(static_cast<int32_t>(rectMax.y), static_cast<int32_t>(height) - 1);
+
+        for (int32_t y = minY; y <= maxY; y++) {
+            const float *row = depthBuffer.data() + y * width;
+            int32_t x = minX;
+#ifdef OCCLUSION_RASTERIZER_SSE2
+            const __m128 boxDepth = _mm_set1_ps(closestDepth);
+            for (; x + 3 <= maxX; x += 4) {
+                if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) != 0) return true;
+            }
+#endif
+            for (; x <= maxX; x++) {
+                if (row[x] >= closestDepth) return true;
+            }
+        }
+        return false;
+    }();
+
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    stats.fTestTime += elapsed.count();
+    stats.testedObjects++;
+    if (!result) stats.occludedObjects++;
+    return result;
+}
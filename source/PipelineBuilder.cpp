@@ -18,6 +18,11 @@ vk::Pipeline PipelineBuilder::build(vk::Device device, vk::RenderPass pass, vk::
         .pAttachments = &colorBlendAttachment,
     };
 
+    vk::PipelineDynamicStateCreateInfo dynamicState{
+        .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+        .pDynamicStates = dynamicStates.data(),
+    };
+
     vk::GraphicsPipelineCreateInfo pipelineInfo{
         .stageCount = static_cast<uint32_t>(shaderStages.size()),
         .pStages = shaderStages.data(),
@@ -28,6 +33,7 @@ vk::Pipeline PipelineBuilder::build(vk::Device device, vk::RenderPass pass, vk::
         .pMultisampleState = &multisampling,
         .pDepthStencilState = &depthStencil,
         .pColorBlendState = &colorBlending,
+        .pDynamicState = (dynamicStates.empty()) ? (nullptr) : (&dynamicState),
         .layout = pipelineLayout,
         .renderPass = pass,
         .subpass = 0,
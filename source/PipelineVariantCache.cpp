@@ -0,0 +1,135 @@
+#include "PipelineVariantCache.hpp"
+
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+size_t PipelineVariantCache::KeyHash::operator()(const Key &key) const noexcept
+{
+    // FNV-1a over the fields
+    size_t hash = 14695981039346656037ull;
+    auto combine = [&hash](uint64_t value) {
+        for (unsigned i = 0; i < sizeof(value); i++) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+    combine(static_cast<uint64_t>(key.polygonMode));
+    combine(static_cast<uint64_t>(key.cullMode));
+    combine(static_cast<uint64_t>(key.msaaSample));
+    combine(static_cast<uint64_t>(key.colorFormat));
+    return hash;
+}
+
+PipelineVariantCache::PipelineVariantCache() {}
+
+PipelineVariantCache::~PipelineVariantCache() {}
+
+void PipelineVariantCache::init(vk::Device &newDevice, Builder &&newBuilder)
+{
+    device = newDevice;
+    builder = std::move(newBuilder);
+    bStop = false;
+    thread = std::thread(&PipelineVariantCache::compileLoop, this);
+}
+
+void PipelineVariantCache::destroy()
+{
+    {
+        std::lock_guard lock(mutex);
+        bStop = true;
+        queue.clear();
+    }
+    queueCondition.notify_all();
+    if (thread.joinable()) thread.join();
+
+    for (auto &[_, variant]: variants) {
+        // Never compiled variants have no value, and failed ones hold an exception
+        if (variant.handle.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+        try {
+            device.destroy(variant.handle.get());
+        } catch (const std::exception &) {
+        }
+    }
+    variants.clear();
+}
+
+void PipelineVariantCache::wait()
+{
+    std::unique_lock lock(mutex);
+    idleCondition.wait(lock, [this] { return queue.empty() && !bCompiling; });
+}
+
+PipelineVariantCache::Handle PipelineVariantCache::request(const Key &key)
+{
+    std::lock_guard lock(mutex);
+    auto [iter, bInserted] = variants.try_emplace(key);
+    if (bInserted) {
+        iter->second.handle = iter->second.promise.get_future().share();
+        queue.push_back(key);
+        queueCondition.notify_one();
+    }
+    return iter->second.handle;
+}
+
+vk::Pipeline PipelineVariantCache::tryGet(const Key &key)
+{
+    const Handle handle = request(key);
+    if (handle.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return VK_NULL_HANDLE;
+    return handle.get();
+}
+
+void PipelineVariantCache::precompile(const std::vector<Key> &keys)
+{
+    for (const auto &key: keys) { request(key); }
+}
+
+size_t PipelineVariantCache::size()
+{
+    std::lock_guard lock(mutex);
+    return variants.size();
+}
+
+size_t PipelineVariantCache::pending()
+{
+    std::lock_guard lock(mutex);
+    return queue.size() + ((bCompiling) ? (1) : (0));
+}
+
+void PipelineVariantCache::compileLoop()
+{
+    std::unique_lock lock(mutex);
+    while (true) {
+        queueCondition.wait(lock, [this] { return bStop || !queue.empty(); });
+        if (bStop) break;
+
+        const Key key = queue.front();
+        queue.pop_front();
+        bCompiling = true;
+        lock.unlock();
+
+        vk::Pipeline pipeline = VK_NULL_HANDLE;
+        std::exception_ptr exception;
+        try {
+            pipeline = builder(key);
+            if (!pipeline) throw std::runtime_error("failed to create the graphics pipeline variant");
+        } catch (...) {
+            exception = std::current_exception();
+        }
+
+        lock.lock();
+        // The references to the map elements are stable
+        auto &promise = variants.at(key).promise;
+        if (exception) {
+            promise.set_exception(exception);
+        } else {
+            promise.set_value(pipeline);
+        }
+        bCompiling = false;
+        if (queue.empty()) idleCondition.notify_all();
+    }
+    // Release the waiters of wait()
+    bCompiling = false;
+    idleCondition.notify_all();
+}
@@ -4,22 +4,24 @@
 #include <string>
 
 #include "Logger.hpp"
+#include "glm/common.hpp"
 #include "glm/vec3.hpp"
 
 Player::Player(): Camera() {}
 
 Player::~Player() {}
 
-void Player::update(float fElapsedTime, float fGravity) noexcept
+void Player::update(float fTimestep, float fGravity) noexcept
 {
     if (fGravity > 0) {
         LOGGER_WARN << "fGravity is positive ! : " << fGravity;
         LOGGER_ENDL;
     }
-    position += vVelocity * fElapsedTime;
+    previousPosition = position;
+    position += vVelocity * fTimestep;
     vVelocity.x = 0;
     vVelocity.z = 0;
-    vVelocity.y += (isFreeFly) ? (-vVelocity.y) : (fGravity);
+    vVelocity.y += (isFreeFly) ? (-vVelocity.y) : (fGravity * fTimestep);
 
     if (position.y < 6 && !isFreeFly) {
         position.y = 6;
@@ -28,6 +30,14 @@ void Player::update(float fElapsedTime, float fGravity) noexcept
     }
 }
 
+Camera Player::getInterpolatedCamera(float fAlpha) const noexcept
+{
+    // The orientation follows the mouse directly, it is not simulated
+    Camera camera = *this;
+    camera.position = glm::mix(previousPosition, position, fAlpha);
+    return camera;
+}
+
 void Player::processKeyboard(const Movement direction) noexcept
 {
     auto velocity = (isFreeFly) ? (50) : (movementSpeed / ((bOnFloor == true) ? (1) : (1.1)));
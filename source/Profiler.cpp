@@ -0,0 +1,101 @@
+#include "Profiler.hpp"
+
+#ifdef CPU_PROFILING
+
+#include <Logger.hpp>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+Profiler::Zone::Zone(const char *name) noexcept: name(name), begin(Profiler::now()) {}
+
+Profiler::Zone::~Zone()
+{
+    Profiler::get().record({
+        .name = name,
+        .begin = begin,
+        .end = Profiler::now(),
+    });
+}
+
+Profiler::Profiler(): start(now()) {}
+
+Profiler::~Profiler() {}
+
+Profiler &Profiler::get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Profiler::ThreadBuffer &Profiler::getThreadBuffer()
+{
+    static thread_local ThreadBuffer *buffer = nullptr;
+    if (buffer) return *buffer;
+
+    auto newBuffer = std::make_unique<ThreadBuffer>();
+    newBuffer->first = std::make_unique<Chunk>();
+    newBuffer->last = newBuffer->first.get();
+
+    std::lock_guard lock(threadMutex);
+    newBuffer->threadID = threads.size();
+    buffer = threads.emplace_back(std::move(newBuffer)).get();
+    return *buffer;
+}
+
+void Profiler::record(const Event &event)
+{
+    auto &buffer = getThreadBuffer();
+    Chunk *chunk = buffer.last;
+    size_t size = chunk->size.load(std::memory_order_relaxed);
+    if (size == Chunk::capacity) {
+        auto *next = new Chunk;
+        chunk->next.store(next, std::memory_order_release);
+        buffer.last = chunk = next;
+        size = 0;
+    }
+    chunk->events[size] = event;
+    // Publish the event to dump()
+    chunk->size.store(size + 1, std::memory_order_release);
+}
+
+void Profiler::dump(const std::filesystem::path &path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("failed to open profiler trace: " + path.string());
+
+    // Nanosecond precision, the default one would truncate timestamps after a few seconds
+    file << std::fixed << std::setprecision(3);
+
+    std::lock_guard lock(threadMutex);
+    size_t nbOfEvents = 0;
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (const auto &thread: threads) {
+        const Chunk *chunk = thread->first.get();
+        for (; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            const size_t size = chunk->size.load(std::memory_order_acquire);
+            for (size_t i = 0; i < size; i++, nbOfEvents++) {
+                const auto &event = chunk->events[i];
+                // Chrome trace timestamps are in microseconds
+                file << ((nbOfEvents > 0) ? (",") : ("")) << "\n{\"name\": \"" << event.name
+                     << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << thread->threadID
+                     << ", \"ts\": " << (event.begin - start) / 1000.0
+                     << ", \"dur\": " << (event.end - event.begin) / 1000.0 << "}";
+            }
+        }
+    }
+    file << "\n]}\n";
+
+    logger->info("PROFILER") << "Wrote " << nbOfEvents << " events to " << path;
+    LOGGER_ENDL;
+}
+
+#endif
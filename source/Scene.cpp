@@ -1,9 +1,114 @@
 #include "types/Scene.hpp"
 
+#include <algorithm>
+#include <utility>
+
 Scene::Scene() {}
 
 Scene::~Scene() {}
 
+void Scene::addObject(RenderObject &&obj)
+{
+    obj.proxyID = spatialIndex.createProxy(getObjectBounds(obj), sceneModels.size());
+    sceneModels.push_back(std::move(obj));
+    bNeedRebuild = true;
+}
+
+void Scene::addObjects(std::vector<RenderObject> &&objects)
+{
+    std::vector<AABB> bounds(objects.size());
+    std::vector<int32_t> proxyIds(objects.size());
+    std::transform(objects.begin(), objects.end(), bounds.begin(),
+                   [&](const RenderObject &obj) { return getObjectBounds(obj); });
+    spatialIndex.createProxies(bounds, sceneModels.size(), proxyIds);
+
+    sceneModels.reserve(sceneModels.size() + objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+        objects[i].proxyID = proxyIds[i];
+        sceneModels.push_back(std::move(objects[i]));
+    }
+    bNeedRebuild = true;
+}
+
+void Scene::removeObject(const uint32_t index)
+{
+    const auto nodeID = sceneModels.at(index).nodeID;
+    if (nodeID != SceneGraph::invalidNode) graph.setUserData(nodeID, SceneGraph::noUserData);
+    spatialIndex.destroyProxy(sceneModels.at(index).proxyID);
+    sceneModels.erase(sceneModels.begin() + index);
+    for (uint32_t i = index; i < sceneModels.size(); i++) { setObjectIndex(i); }
+    bNeedRebuild = true;
+}
+
+void Scene::updateObject(const uint32_t index, const gpuObject::UniformBufferObject &ubo)
+{
+    auto &obj = sceneModels.at(index);
+    const AABB oldBounds = getObjectBounds(obj);
+    obj.ubo = ubo;
+    const AABB newBounds = getObjectBounds(obj);
+    spatialIndex.moveProxy(obj.proxyID, newBounds, newBounds.getCenter() - oldBounds.getCenter());
+    dirtyObjects.add(index, index + 1);
+}
+
+SceneGraph::NodeID Scene::attachObject(const uint32_t index, SceneGraph::NodeID parent)
+{
+    auto &obj = sceneModels.at(index);
+    if (obj.nodeID != SceneGraph::invalidNode) {
+        graph.setParent(obj.nodeID, parent);
+    } else {
+        obj.nodeID = graph.createNode(obj.getModelMatrix(), parent, index);
+    }
+    return obj.nodeID;
+}
+
+void Scene::destroyNode(SceneGraph::NodeID node)
+{
+    graph.destroyNode(node, [this](uint32_t index) { sceneModels[index].nodeID = SceneGraph::invalidNode; });
+}
+
+Scene::DirtyRange Scene::update()
+{
+    getDrawBatch();
+    graph.update([this](uint32_t index, const glm::mat4 &worldTransform) {
+        auto ubo = sceneModels[index].ubo;
+        ubo.transform = {
+            .translation = worldTransform,
+            .rotation = glm::mat4{1.0f},
+            .scale = glm::mat4{1.0f},
+        };
+        updateObject(index, ubo);
+    });
+    return std::exchange(dirtyObjects, {});
+}
+
+AABB Scene::getObjectBounds(const RenderObject &obj) const
+{
+    const auto model = obj.getModelMatrix();
+    auto bounds = meshBounds.find(obj.meshID);
+    if (bounds == meshBounds.end()) {
+        const glm::vec3 position(model[3]);
+        return {
+            .min = position,
+            .max = position,
+        };
+    }
+    return bounds->second.transform(model);
+}
+
+std::optional<uint32_t> Scene::rayCast(const Ray &ray) const
+{
+    std::optional<uint32_t> closest;
+
+    spatialIndex.rayCast(ray, [&](int32_t proxyID, const Ray &currentRay) {
+        const uint32_t index = spatialIndex.getUserData(proxyID);
+        const float distance = currentRay.intersect(getObjectBounds(sceneModels[index]));
+        if (distance < 0.0f) return -1.0f;
+        closest = index;
+        return distance;
+    });
+    return closest;
+}
+
 const std::vector<Scene::DrawBatch> &Scene::getDrawBatch(const bool bForceRebuild)
 {
     if (bNeedRebuild || bForceRebuild) { this->buildDrawBatch(); }
@@ -12,9 +117,15 @@ const std::vector<Scene::DrawBatch> &Scene::getDrawBatch(const bool bForceRebuil
 
 void Scene::buildDrawBatch()
 {
-    std::sort(sceneModels.begin(), sceneModels.end(),
-              [](const auto &first, const auto &second) { return first.meshID == second.meshID; });
     cachedBatch.clear();
+    bNeedRebuild = false;
+    if (sceneModels.empty()) return;
+
+    std::stable_sort(sceneModels.begin(), sceneModels.end(),
+                     [](const auto &first, const auto &second) { return first.meshID < second.meshID; });
+    for (uint32_t i = 0; i < sceneModels.size(); i++) { setObjectIndex(i); }
+    invalidate();
+
     cachedBatch.push_back({
         .meshId = sceneModels.at(0).meshID,
         .first = 0,
@@ -32,5 +143,11 @@ void Scene::buildDrawBatch()
             });
         }
     }
-    bNeedRebuild = false;
+}
+
+void Scene::setObjectIndex(const uint32_t index)
+{
+    const auto &obj = sceneModels[index];
+    spatialIndex.setUserData(obj.proxyID, index);
+    if (obj.nodeID != SceneGraph::invalidNode) graph.setUserData(obj.nodeID, index);
 }
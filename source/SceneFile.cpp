@@ -0,0 +1,232 @@
+#include "SceneFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define SCENE_FILE_MMAP
+#endif
+
+static constexpr uint64_t alignOffset(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+SceneFile::SceneFile(const std::filesystem::path &path)
+{
+#ifdef SCENE_FILE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("failed to open scene file: " + path.string());
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("failed to read scene file: " + path.string());
+    }
+    size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) throw std::runtime_error("failed to map scene file: " + path.string());
+    data = static_cast<const std::byte *>(mapped);
+#else
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("failed to open scene file: " + path.string());
+    size = file.tellg();
+    fallbackBuffer.resize(size);
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(fallbackBuffer.data()), size);
+    data = fallbackBuffer.data();
+#endif
+
+    try {
+        validate();
+    } catch (...) {
+#ifdef SCENE_FILE_MMAP
+        munmap(const_cast<std::byte *>(data), size);
+#endif
+        throw;
+    }
+}
+
+SceneFile::~SceneFile()
+{
+#ifdef SCENE_FILE_MMAP
+    if (data) munmap(const_cast<std::byte *>(data), size);
+#endif
+}
+
+void SceneFile::validate() const
+{
+    if (size < sizeof(Header)) throw std::runtime_error("scene file is too small");
+
+    const Header &header = getHeader();
+    if (header.magic != magic) throw std::runtime_error("not a scene file");
+    if (header.version != version) throw std::runtime_error("unsupported scene file version");
+    if (header.objectSize != sizeof(gpuObject::UniformBufferObject)) {
+        throw std::runtime_error("scene file object layout does not match");
+    }
+
+    const uint64_t nameCount = uint64_t(header.meshCount) + header.textureCount;
+    if (header.namesOffset + nameCount * sizeof(Name) > size ||
+        header.objectsOffset + uint64_t(header.objectCount) * sizeof(gpuObject::UniformBufferObject) > size ||
+        header.infosOffset + uint64_t(header.objectCount) * sizeof(ObjectInfo) > size) {
+        throw std::runtime_error("scene file is truncated");
+    }
+    if (header.objectsOffset % alignof(gpuObject::UniformBufferObject) != 0 ||
+        header.infosOffset % alignof(ObjectInfo) != 0) {
+        throw std::runtime_error("scene file is misaligned");
+    }
+    for (const auto &info: getObjectInfos()) {
+        if (info.meshIndex >= header.meshCount) throw std::runtime_error("scene file has an invalid mesh index");
+    }
+    for (const auto &object: getObjects()) {
+        if (object.textureIndex >= header.textureCount) {
+            throw std::runtime_error("scene file has an invalid texture index");
+        }
+    }
+}
+
+std::string_view SceneFile::getName(uint32_t index) const
+{
+    const auto *names = reinterpret_cast<const Name *>(data + getHeader().namesOffset);
+    return std::string_view(names[index].str, strnlen(names[index].str, nameSize));
+}
+
+std::string_view SceneFile::getMeshName(uint32_t index) const
+{
+    if (index >= getHeader().meshCount) throw std::out_of_range("mesh index out of range");
+    return getName(index);
+}
+
+std::string_view SceneFile::getTextureName(uint32_t index) const
+{
+    if (index >= getHeader().textureCount) throw std::out_of_range("texture index out of range");
+    return getName(getHeader().meshCount + index);
+}
+
+std::span<const gpuObject::UniformBufferObject> SceneFile::getObjects() const noexcept
+{
+    return {reinterpret_cast<const gpuObject::UniformBufferObject *>(data + getHeader().objectsOffset),
+            getHeader().objectCount};
+}
+
+std::span<const SceneFile::ObjectInfo> SceneFile::getObjectInfos() const noexcept
+{
+    return {reinterpret_cast<const ObjectInfo *>(data + getHeader().infosOffset), getHeader().objectCount};
+}
+
+void SceneFile::write(const std::filesystem::path &path, const std::vector<std::string> &meshNames,
+                      const std::vector<std::string> &textureNames,
+                      std::span<const gpuObject::UniformBufferObject> objects, std::span<const ObjectInfo> infos)
+{
+    if (objects.size() != infos.size()) throw std::invalid_argument("objects and infos must have the same size");
+
+    Header header{
+        .magic = magic,
+        .version = version,
+        .objectSize = sizeof(gpuObject::UniformBufferObject),
+        .meshCount = static_cast<uint32_t>(meshNames.size()),
+        .textureCount = static_cast<uint32_t>(textureNames.size()),
+        .objectCount = static_cast<uint32_t>(objects.size()),
+        .namesOffset = sizeof(Header),
+        .objectsOffset = 0,
+        .infosOffset = 0,
+    };
+    header.objectsOffset = alignOffset(header.namesOffset + (meshNames.size() + textureNames.size()) * sizeof(Name),
+                                       alignof(gpuObject::UniformBufferObject));
+    header.infosOffset = alignOffset(header.objectsOffset + objects.size_bytes(), alignof(ObjectInfo));
+
+    std::vector<std::byte> buffer(header.infosOffset + infos.size_bytes());
+    std::memcpy(buffer.data(), &header, sizeof(header));
+
+    auto *names = reinterpret_cast<Name *>(buffer.data() + header.namesOffset);
+    for (const auto &name: meshNames) {
+        if (name.size() >= nameSize) throw std::invalid_argument("name is too long: " + name);
+        std::strncpy((names++)->str, name.c_str(), nameSize);
+    }
+    for (const auto &name: textureNames) {
+        if (name.size() >= nameSize) throw std::invalid_argument("name is too long: " + name);
+        std::strncpy((names++)->str, name.c_str(), nameSize);
+    }
+    std::memcpy(buffer.data() + header.objectsOffset, objects.data(), objects.size_bytes());
+    std::memcpy(buffer.data() + header.infosOffset, infos.data(), infos.size_bytes());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) throw std::runtime_error("failed to open scene file: " + path.string());
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+}
+
+void SceneFile::convert(const std::filesystem::path &textPath, const std::filesystem::path &binaryPath)
+{
+    std::ifstream file(textPath);
+    if (!file.is_open()) throw std::runtime_error("failed to open scene description: " + textPath.string());
+
+    std::vector<std::string> meshNames;
+    std::vector<std::string> textureNames;
+    std::unordered_map<std::string, uint32_t> meshIndices;
+    std::unordered_map<std::string, uint32_t> textureIndices;
+    std::vector<gpuObject::UniformBufferObject> objects;
+    std::vector<ObjectInfo> infos;
+
+    auto getIndex = [](std::unordered_map<std::string, uint32_t> &indices, std::vector<std::string> &names,
+                       const std::string &name) {
+        auto [iter, bInserted] = indices.try_emplace(name, names.size());
+        if (bInserted) names.push_back(name);
+        return iter->second;
+    };
+
+    std::string line;
+    for (unsigned lineNumber = 1; std::getline(file, line); lineNumber++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream stream(line);
+        std::string statement;
+        if (!(stream >> statement)) continue;
+        if (statement != "object") {
+            throw std::runtime_error(textPath.string() + ":" + std::to_string(lineNumber) + ": unknown statement " +
+                                     statement);
+        }
+
+        std::string mesh, texture, flag;
+        glm::vec3 translation, rotation, scale;
+        if (!(stream >> mesh >> texture >> translation.x >> translation.y >> translation.z >> rotation.x >>
+              rotation.y >> rotation.z >> scale.x >> scale.y >> scale.z)) {
+            throw std::runtime_error(textPath.string() + ":" + std::to_string(lineNumber) + ": invalid object");
+        }
+
+        ObjectInfo info{
+            .meshIndex = getIndex(meshIndices, meshNames, mesh),
+            .flags = 0,
+        };
+        while (stream >> flag) {
+            if (flag == "occluder") {
+                info.flags |= ObjectFlags::Occluder;
+            } else {
+                throw std::runtime_error(textPath.string() + ":" + std::to_string(lineNumber) + ": unknown flag " +
+                                         flag);
+            }
+        }
+
+        objects.push_back({
+            .transform =
+                {
+                    .translation = glm::translate(glm::mat4{1.0f}, translation),
+                    .rotation = glm::toMat4(glm::quat(glm::radians(rotation))),
+                    .scale = glm::scale(glm::mat4{1.0f}, scale),
+                },
+            .textureIndex = getIndex(textureIndices, textureNames, texture),
+        });
+        infos.push_back(info);
+    }
+    write(binaryPath, meshNames, textureNames, objects, infos);
+}
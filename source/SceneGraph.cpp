@@ -0,0 +1,146 @@
+#include "SceneGraph.hpp"
+
+#include <numeric>
+#include <stdexcept>
+
+template <typename T>
+static void reorder(std::vector<T> &values, const std::vector<uint32_t> &order)
+{
+    std::vector<T> reordered;
+    reordered.reserve(order.size());
+    for (const uint32_t index: order) reordered.push_back(values[index]);
+    values = std::move(reordered);
+}
+
+SceneGraph::SceneGraph() {}
+
+SceneGraph::~SceneGraph() {}
+
+SceneGraph::NodeID SceneGraph::createNode(const glm::mat4 &localTransform, NodeID parent, uint32_t data)
+{
+    const uint32_t parentIndex = (parent == invalidNode) ? (invalidNode) : (getIndex(parent));
+    const uint32_t index = nodeIDs.size();
+
+    NodeID node;
+    if (freeIDs.empty()) {
+        node = indices.size();
+        indices.push_back(index);
+    } else {
+        node = freeIDs.back();
+        freeIDs.pop_back();
+        indices[node] = index;
+    }
+
+    // Appending keeps the parent before its child
+    nodeIDs.push_back(node);
+    parentIndices.push_back(parentIndex);
+    depths.push_back((parentIndex == invalidNode) ? (0) : (depths[parentIndex] + 1));
+    localTransforms.push_back(localTransform);
+    worldTransforms.push_back(localTransform);
+    userData.push_back(data);
+    dirty.push_back(false);
+    markDirty(index);
+    return node;
+}
+
+void SceneGraph::destroyNode(NodeID node)
+{
+    destroyNode(node, [](uint32_t) {});
+}
+
+void SceneGraph::setParent(NodeID node, NodeID parent)
+{
+    const uint32_t index = getIndex(node);
+    const uint32_t parentIndex = (parent == invalidNode) ? (invalidNode) : (getIndex(parent));
+
+    for (uint32_t ancestor = parentIndex; ancestor != invalidNode; ancestor = parentIndices[ancestor]) {
+        if (ancestor == index) throw std::invalid_argument("a node can not be parented to its own descendant");
+    }
+    parentIndices[index] = parentIndex;
+    bNeedSort = true;
+    markDirty(index);
+}
+
+void SceneGraph::setLocalTransform(NodeID node, const glm::mat4 &localTransform)
+{
+    const uint32_t index = getIndex(node);
+    localTransforms[index] = localTransform;
+    markDirty(index);
+}
+
+void SceneGraph::clear()
+{
+    indices.clear();
+    freeIDs.clear();
+    nodeIDs.clear();
+    parentIndices.clear();
+    depths.clear();
+    localTransforms.clear();
+    worldTransforms.clear();
+    userData.clear();
+    dirty.clear();
+    firstDirty = invalidNode;
+    bNeedSort = false;
+}
+
+uint32_t SceneGraph::getIndex(NodeID node) const
+{
+    if (!isValid(node)) throw std::out_of_range("invalid scene graph node");
+    return indices[node];
+}
+
+void SceneGraph::markDirty(uint32_t index)
+{
+    dirty[index] = true;
+    firstDirty = std::min(firstDirty, index);
+}
+
+void SceneGraph::sortNodes()
+{
+    // After a reparenting the storage is no longer ordered, so the depths are computed by walking up the
+    // hierarchy, stopping at the first node already computed
+    std::vector<uint8_t> bComputed(nodeIDs.size(), false);
+    std::vector<uint32_t> chain;
+    for (uint32_t i = 0; i < nodeIDs.size(); i++) {
+        uint32_t current = i;
+        while (current != invalidNode && !bComputed[current]) {
+            chain.push_back(current);
+            current = parentIndices[current];
+        }
+        uint32_t depth = (current == invalidNode) ? (0) : (depths[current] + 1);
+        for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter, depth++) {
+            depths[*iter] = depth;
+            bComputed[*iter] = true;
+        }
+        chain.clear();
+    }
+
+    std::vector<uint32_t> order(nodeIDs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+    applyOrder(order);
+    bNeedSort = false;
+}
+
+void SceneGraph::applyOrder(const std::vector<uint32_t> &order)
+{
+    std::vector<uint32_t> newIndices(nodeIDs.size(), invalidNode);
+    for (uint32_t i = 0; i < order.size(); i++) newIndices[order[i]] = i;
+    for (auto &parent: parentIndices) {
+        if (parent != invalidNode) parent = newIndices[parent];
+    }
+
+    reorder(nodeIDs, order);
+    reorder(parentIndices, order);
+    reorder(depths, order);
+    reorder(localTransforms, order);
+    reorder(worldTransforms, order);
+    reorder(userData, order);
+    reorder(dirty, order);
+
+    firstDirty = invalidNode;
+    for (uint32_t i = 0; i < nodeIDs.size(); i++) {
+        indices[nodeIDs[i]] = i;
+        if (dirty[i] && firstDirty == invalidNode) firstDirty = i;
+    }
+}
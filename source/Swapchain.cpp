@@ -3,6 +3,7 @@
 #include <optional>
 #include <stddef.h>
 #include <stdexcept>
+#include <tuple>
 
 #include "DebugMacros.hpp"
 #include "QueueFamilyIndices.hpp"
@@ -15,21 +16,74 @@ Swapchain::Swapchain() {}
 
 Swapchain::~Swapchain() {}
 
-void Swapchain::init(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface)
+void Swapchain::init(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+                     const CreationParameters &parameters)
 {
     DEBUG_FUNCTION
-    createSwapchain(win, gpu, device, surface);
+    createSwapchain(win, gpu, device, surface, parameters);
     getImages(device);
     createImageViews(device);
 }
 
+void Swapchain::initOffscreen(vk::Extent2D extent, uint32_t nbOfImages, vk::Device &device, vma::Allocator &allocator)
+{
+    DEBUG_FUNCTION
+    bOffscreen = true;
+    // The format preferred on a surface, so the rendering path is the same
+    swapChainImageFormat = vk::Format::eB8G8R8A8Srgb;
+    swapChainExtent = extent;
+
+    vk::ImageCreateInfo imageInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = swapChainImageFormat,
+        .extent = getSwapchainExtent3D(),
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+    vma::AllocationCreateInfo allocInfo{};
+    allocInfo.usage = vma::MemoryUsage::eGpuOnly;
+
+    swapChainImages.resize(nbOfImages);
+    offscreenMemory.resize(nbOfImages);
+    for (uint32_t i = 0; i < nbOfImages; i++) {
+        std::tie(swapChainImages.at(i), offscreenMemory.at(i)) = allocator.createImage(imageInfo, allocInfo);
+    }
+    chainDeletionQueue.push([&]() {
+        for (uint32_t i = 0; i < swapChainImages.size(); i++) {
+            allocator.destroyImage(swapChainImages.at(i), offscreenMemory.at(i));
+        }
+        swapChainImages.clear();
+        offscreenMemory.clear();
+    });
+    createImageViews(device);
+}
+
 void Swapchain::destroy() { chainDeletionQueue.flush(); }
 
-void Swapchain::recreate(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface)
+void Swapchain::recreate(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+                         const CreationParameters &parameters)
 {
     DEBUG_FUNCTION
     this->destroy();
-    this->init(win, gpu, device, surface);
+    this->init(win, gpu, device, surface, parameters);
+}
+
+void Swapchain::resize(Window &win, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+                       const CreationParameters &parameters, DeferredDestructionQueue &retired, uint64_t lastUse)
+{
+    DEBUG_FUNCTION
+    // The queue entries replace the deletions of the previous chain
+    for (const auto &imageView: swapChainImageViews) { retired.push(lastUse, imageView); }
+    retired.push(lastUse, swapChain);
+    chainDeletionQueue = {};
+    createSwapchain(win, gpu, device, surface, parameters, swapChain);
+    getImages(device);
+    createImageViews(device);
 }
 
 uint32_t Swapchain::nbOfImage() const
@@ -39,19 +93,17 @@ uint32_t Swapchain::nbOfImage() const
     return swapChainImages.size();
 }
 
-void Swapchain::createSwapchain(Window &window, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface)
+void Swapchain::createSwapchain(Window &window, vk::PhysicalDevice &gpu, vk::Device &device, vk::SurfaceKHR &surface,
+                                const CreationParameters &parameters, vk::SwapchainKHR oldSwapchain)
 {
     DEBUG_FUNCTION
     auto indices = QueueFamilyIndices::findQueueFamilies(gpu, surface);
 
     auto swapChainSupport = SupportDetails::querySwapChainSupport(gpu, surface);
     auto surfaceFormat = swapChainSupport.chooseSwapSurfaceFormat();
-    auto presentMode = swapChainSupport.chooseSwapPresentMode();
+    presentMode = swapChainSupport.chooseSwapPresentMode(parameters.presentMode);
     auto extent = swapChainSupport.chooseSwapExtent(window);
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-    if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-        imageCount = swapChainSupport.capabilities.maxImageCount;
-    }
+    uint32_t imageCount = swapChainSupport.chooseImageCount(parameters.swapchainImageCount);
 
     vk::SwapchainCreateInfoKHR createInfo{
         .surface = surface,
@@ -65,7 +117,7 @@ void Swapchain::createSwapchain(Window &window, vk::PhysicalDevice &gpu, vk::Dev
         .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
         .presentMode = presentMode,
         .clipped = VK_TRUE,
-        .oldSwapchain = nullptr,
+        .oldSwapchain = oldSwapchain,
     };
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
@@ -80,7 +132,8 @@ void Swapchain::createSwapchain(Window &window, vk::PhysicalDevice &gpu, vk::Dev
     }
 
     swapChain = device.createSwapchainKHR(createInfo);
-    chainDeletionQueue.push([&]() { device.destroy(swapChain); });
+    // By value, as resize() keeps the previous handles alive after they are replaced
+    chainDeletionQueue.push([&device, chain = swapChain]() { device.destroy(chain); });
     swapChainImageFormat = surfaceFormat.format;
     swapChainExtent = extent;
 }
@@ -100,7 +153,7 @@ void Swapchain::createImageViews(vk::Device &device)
             vk_init::populateVkImageViewCreateInfo(this->getSwapchainImage(i), this->getSwapchainFormat());
         swapChainImageViews.at(i) = device.createImageView(createInfo);
     }
-    chainDeletionQueue.push([&]() {
-        for (auto &imageView: swapChainImageViews) { vkDestroyImageView(device, imageView, nullptr); }
+    chainDeletionQueue.push([&device, imageViews = swapChainImageViews]() {
+        for (auto &imageView: imageViews) { vkDestroyImageView(device, imageView, nullptr); }
     });
 }
@@ -12,15 +12,26 @@ vk::SurfaceFormatKHR Swapchain::SupportDetails::chooseSwapSurfaceFormat() noexce
     return formats.at(0);
 }
 
-vk::PresentModeKHR Swapchain::SupportDetails::chooseSwapPresentMode() noexcept
+vk::PresentModeKHR Swapchain::SupportDetails::chooseSwapPresentMode(vk::PresentModeKHR preferredMode) noexcept
 {
     for (const auto &availablePresentMode: presentModes) {
-        if (availablePresentMode == vk::PresentModeKHR::eMailbox) { return availablePresentMode; }
+        if (availablePresentMode == preferredMode) { return availablePresentMode; }
     }
 
+    // The only mode required by the specification
     return vk::PresentModeKHR::eFifo;
 }
 
+uint32_t Swapchain::SupportDetails::chooseImageCount(uint32_t requestedCount) noexcept
+{
+    uint32_t imageCount = (requestedCount == 0) ? (capabilities.minImageCount + 1)
+                                                : (std::max(requestedCount, capabilities.minImageCount));
+    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
+        imageCount = capabilities.maxImageCount;
+    }
+    return imageCount;
+}
+
 vk::Extent2D Swapchain::SupportDetails::chooseSwapExtent(Window &window) noexcept
 {
     if (capabilities.currentExtent.width != UINT32_MAX) {
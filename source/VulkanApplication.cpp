@@ -1,10 +1,15 @@
 #include "VulkanApplication.hpp"
 
 #include <Window.hpp>
+#include <algorithm>
 #include <array>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iterator>
 #include <map>
 #include <numeric>
@@ -12,12 +17,14 @@
 #include <ranges>
 #include <set>
 #include <stdexcept>
+#include <utility>
 #include <vk_mem_alloc.hpp>
 
 #include "Camera.hpp"
 #include "DebugMacros.hpp"
 #include "Logger.hpp"
 #include "PipelineBuilder.hpp"
+#include "Profiler.hpp"
 #include "QueueFamilyIndices.hpp"
 #include "imgui.h"
 #include "types/Material.hpp"
@@ -27,13 +34,12 @@
 #include "vk_init.hpp"
 #include "vk_utils.hpp"
 
-#define MAX_OBJECT 1000
-#define MAX_COMMANDS 100
-#define MAX_MATERIALS 100
-
-VulkanApplication::VulkanApplication(): VulkanLoader(), window("Vulkan", 800, 600)
+VulkanApplication::VulkanApplication(bool bHeadless, const CreationParameters &parameters)
+    : VulkanLoader(), creationParameters(parameters), window("Vulkan", 800, 600, bHeadless)
 {
     DEBUG_FUNCTION
+    creationParameters.framesInFlight =
+        std::clamp<uint32_t>(creationParameters.framesInFlight, 1, MAX_FRAME_FRAME_IN_FLIGHT);
     window.setUserPointer(this);
     window.setResizeCallback(framebufferResizeCallback);
 }
@@ -42,6 +48,9 @@ VulkanApplication::~VulkanApplication()
 {
     DEBUG_FUNCTION
     if (device) device.waitIdle();
+    // The compile thread reads the render pass, it must be stopped before the swapchain resources are destroyed
+    pipelineVariants.destroy();
+    extentResources.flush();
     if (swapchain) swapchain.destroy();
     swapchainDeletionQueue.flush();
     mainDeletionQueue.flush();
@@ -50,34 +59,60 @@ VulkanApplication::~VulkanApplication()
 void VulkanApplication::init(std::function<bool()> &&loadingStage)
 {
     DEBUG_FUNCTION
-    initInstance();
-    initDebug();
-    initSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-
-    swapchain.init(window, physical_device, device, surface);
-
-    createAllocator();
-    createSyncObjects();
-    createIndirectBuffer();
-    createRenderPass();
-    createDescriptorSetLayout();
-    createTextureDescriptorSetLayout();
-    createPipelineCache();
-    createPipelineLayout();
-    createGraphicsPipeline();
-    createCommandPool();
-    createColorResources();
-    createDepthResources();
-    createFramebuffers();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
+    PROFILE_FUNCTION;
+    {
+        PROFILE_SCOPE("Device creation");
+        initInstance();
+        initDebug();
+        initSurface();
+        pickPhysicalDevice();
+        createLogicalDevice();
+        createAllocator();
+
+        if (window.isHeadless()) {
+            swapchain.initOffscreen(window.getSize(), MAX_FRAME_FRAME_IN_FLIGHT, device, allocator);
+        } else {
+            swapchain.init(window, physical_device, device, surface, creationParameters);
+        }
+    }
+    {
+        PROFILE_SCOPE("Pipeline creation");
+        createSyncObjects();
+        createIndirectBuffer();
+        createRenderPass();
+        createDescriptorSetLayout();
+        createTextureDescriptorSetLayout();
+        createPipelineCache();
+        createPipelineLayout();
+        createPipelineVariants();
+        updateGraphicsPipeline();
+    }
+    {
+        PROFILE_SCOPE("Resource creation");
+        createCommandPool();
+        createGPUProfiler();
+        createStatisticsQueries();
+        createColorResources();
+        createDepthResources();
+        createFramebuffers();
+        createUniformBuffers();
+        createDescriptorPool();
+        createDescriptorSets();
+    }
+    {
+        PROFILE_SCOPE("Occlusion culling creation");
+        createOcclusionCullingLayouts();
+        createOcclusionCullingPipelines();
+        createDepthPyramid();
+        createOcclusionCullingDescriptors();
+    }
 
-    createImgui();
+    if (!window.isHeadless()) createImgui();
 
-    if (!loadingStage()) { throw std::runtime_error("Loading stage failed !"); }
+    {
+        PROFILE_SCOPE("Loading stage");
+        if (!loadingStage()) { throw std::runtime_error("Loading stage failed !"); }
+    }
 
     createTextureSampler();
     createTextureDescriptorSets();
@@ -92,7 +127,7 @@ void VulkanApplication::initInstance()
     }
 
     auto debugInfo = vk_init::populateDebugUtilsMessengerCreateInfoEXT(&VulkanApplication::debugCallback);
-    auto extensions = Window::getRequiredExtensions();
+    auto extensions = (window.isHeadless()) ? (std::vector<const char *>{}) : (Window::getRequiredExtensions());
     if (enableValidationLayers) { extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); }
 
     vk::ApplicationInfo applicationInfo{
@@ -150,6 +185,7 @@ void VulkanApplication::pickPhysicalDevice()
 void VulkanApplication::initSurface()
 {
     DEBUG_FUNCTION
+    if (window.isHeadless()) return;
     surface = window.createSurface(instance);
     mainDeletionQueue.push([&] { instance.destroy(surface); });
 }
@@ -172,22 +208,63 @@ void VulkanApplication::createLogicalDevice()
         .descriptorBindingVariableDescriptorCount = VK_TRUE,
         .runtimeDescriptorArray = VK_TRUE,
     };
-    vk::PhysicalDeviceVulkan11Features v11Features{
+    vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicState{
+        .pNext = &descriptorIndex,
+        .extendedDynamicState = VK_TRUE,
+    };
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphore{
         .pNext = &descriptorIndex,
+        .timelineSemaphore = VK_TRUE,
+    };
+    vk::PhysicalDeviceVulkan11Features v11Features{
+        .pNext = &timelineSemaphore,
         .shaderDrawParameters = VK_TRUE,
     };
 
+    const auto supportedFeatures = physical_device.getFeatures();
+    bMultiDrawIndirectSupported = supportedFeatures.multiDrawIndirect;
+    maxDrawIndirectCount = physical_device.getProperties().limits.maxDrawIndirectCount;
+    if (!bMultiDrawIndirectSupported) {
+        logger->warn("Device") << "multiDrawIndirect is not supported, falling back to one draw per batch";
+        LOGGER_ENDL;
+    }
+    // The draws are recorded in secondary command buffers, which must inherit the query
+    bPipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery && supportedFeatures.inheritedQueries;
+    if (!bPipelineStatisticsSupported) {
+        logger->warn("Device") << "Pipeline statistics queries are not supported";
+        LOGGER_ENDL;
+    }
+
     vk::PhysicalDeviceFeatures deviceFeature{
+        .multiDrawIndirect = supportedFeatures.multiDrawIndirect,
         .drawIndirectFirstInstance = VK_TRUE,
         .fillModeNonSolid = VK_TRUE,
         .samplerAnisotropy = VK_TRUE,
+        .pipelineStatisticsQuery = bPipelineStatisticsSupported,
+        .inheritedQueries = bPipelineStatisticsSupported,
     };
+    auto extensions = getDeviceExtensions(!window.isHeadless());
+    // Optional, the cull mode is otherwise part of the pipeline variant
+    const auto availableExtensions = physical_device.enumerateDeviceExtensionProperties();
+    bExtendedDynamicStateSupported =
+        std::ranges::any_of(availableExtensions, [](const vk::ExtensionProperties &extension) {
+            return strcmp(extension.extensionName, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) == 0;
+        }) &&
+        physical_device
+            .getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>()
+            .get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>()
+            .extendedDynamicState;
+    if (bExtendedDynamicStateSupported) {
+        extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        timelineSemaphore.pNext = &extendedDynamicState;
+    }
+
     vk::DeviceCreateInfo createInfo{
         .pNext = &v11Features,
         .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
         .pQueueCreateInfos = queueCreateInfos.data(),
-        .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
-        .ppEnabledExtensionNames = deviceExtensions.data(),
+        .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+        .ppEnabledExtensionNames = extensions.data(),
         .pEnabledFeatures = &deviceFeature,
     };
     this->VulkanLoader::createLogicalDevice(physical_device, createInfo);
@@ -214,23 +291,30 @@ void VulkanApplication::createAllocator()
 void VulkanApplication::createRenderPass()
 {
     DEBUG_FUNCTION
+    // With occlusion culling, the frame is drawn in two passes and the second one must keep the attachments
+    const vk::AttachmentStoreOp storeOp =
+        (creationParameters.bOcclusionCulling) ? (vk::AttachmentStoreOp::eStore) : (vk::AttachmentStoreOp::eDontCare);
+    vk::FormatFeatureFlags depthFeatures = vk::FormatFeatureFlagBits::eDepthStencilAttachment;
+    if (creationParameters.bOcclusionCulling) depthFeatures |= vk::FormatFeatureFlagBits::eSampledImage;
+    depthFormat = vk_utils::findSupportedFormat(
+        physical_device, {vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint},
+        vk::ImageTiling::eOptimal, depthFeatures);
+
     vk::AttachmentDescription colorAttachment{
         .format = swapchain.getSwapchainFormat(),
         .samples = creationParameters.msaaSample,
         .loadOp = vk::AttachmentLoadOp::eClear,
-        .storeOp = vk::AttachmentStoreOp::eDontCare,
+        .storeOp = storeOp,
         .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
         .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
         .initialLayout = vk::ImageLayout::eUndefined,
         .finalLayout = vk::ImageLayout::eColorAttachmentOptimal,
     };
     vk::AttachmentDescription depthAttachment{
-        .format = vk_utils::findSupportedFormat(
-            physical_device, {vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint},
-            vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment),
+        .format = depthFormat,
         .samples = creationParameters.msaaSample,
         .loadOp = vk::AttachmentLoadOp::eClear,
-        .storeOp = vk::AttachmentStoreOp::eDontCare,
+        .storeOp = storeOp,
         .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
         .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
         .initialLayout = vk::ImageLayout::eUndefined,
@@ -244,7 +328,7 @@ void VulkanApplication::createRenderPass()
         .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
         .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
         .initialLayout = vk::ImageLayout::eUndefined,
-        .finalLayout = vk::ImageLayout::ePresentSrcKHR,
+        .finalLayout = swapchain.getImageLayout(),
     };
     vk::AttachmentReference colorAttachmentRef{
         .attachment = 0,
@@ -287,31 +371,158 @@ void VulkanApplication::createRenderPass()
     };
     renderPass = device.createRenderPass(renderPassInfo);
     swapchainDeletionQueue.push([&] { device.destroy(renderPass); });
+
+    if (!creationParameters.bOcclusionCulling) return;
+
+    colorAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+    colorAttachment.initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    depthAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+    depthAttachment.initialLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
+    dependency.srcStageMask |= vk::PipelineStageFlagBits::eComputeShader;
+    dependency.dstAccessMask |=
+        vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentRead;
+    renderPassLoad = device.createRenderPass(renderPassInfo);
+    swapchainDeletionQueue.push([&] { device.destroy(renderPassLoad); });
 }
 
 void VulkanApplication::createPipelineCache()
 {
     DEBUG_FUNCTION
-    vk::PipelineCacheCreateInfo createInfo;
+    const auto data = loadPipelineCache();
+    vk::PipelineCacheCreateInfo createInfo{
+        .initialDataSize = data.size(),
+        .pInitialData = data.data(),
+    };
     pipelineCache = device.createPipelineCache(createInfo);
-    mainDeletionQueue.push([&] { device.destroy(pipelineCache); });
+    bPipelineCacheWarm = !data.empty();
+    // Pushed before the pipelines, so it is saved once they are all compiled
+    mainDeletionQueue.push([&] {
+        savePipelineCache();
+        device.destroy(pipelineCache);
+    });
 }
 
-void VulkanApplication::createPipelineLayout()
+std::vector<std::byte> VulkanApplication::loadPipelineCache()
 {
     DEBUG_FUNCTION
-    std::vector<vk::PushConstantRange> pipelinePushConstant = {vk_init::populateVkPushConstantRange(
-        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, sizeof(Camera::GPUCameraData))};
+    std::ifstream file(pipelineCachePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return {};
+    std::vector<std::byte> data(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(data.data()), data.size());
+
+    // VkPipelineCacheHeaderVersionOne. Drivers should reject a foreign cache themselves, but not all of them do.
+    struct {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    } header = {};
+    const auto properties = physical_device.getProperties();
+    if (!file || data.size() < sizeof(header)) {
+        logger->warn("PIPELINE_CACHE") << "Ignoring the truncated cache " << pipelineCachePath;
+        LOGGER_ENDL;
+        return {};
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.headerSize < sizeof(header) ||
+        header.headerVersion != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne) ||
+        header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+        std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+        logger->warn("PIPELINE_CACHE") << "Ignoring " << pipelineCachePath << ", written by another device or driver";
+        LOGGER_ENDL;
+        return {};
+    }
+
+    logger->info("PIPELINE_CACHE") << "Loaded " << data.size() << " bytes from " << pipelineCachePath;
+    LOGGER_ENDL;
+    return data;
+}
+
+void VulkanApplication::savePipelineCache()
+try {
+    DEBUG_FUNCTION
+    const auto data = device.getPipelineCacheData(pipelineCache);
+    const std::filesystem::path tmpPath = std::string(pipelineCachePath) + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) throw std::runtime_error("failed to open " + tmpPath.string());
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        if (!file) throw std::runtime_error("failed to write " + tmpPath.string());
+    }
+    // Replaces the previous cache at once, so an interrupted exit never leaves a truncated file
+    std::filesystem::rename(tmpPath, pipelineCachePath);
+    logger->info("PIPELINE_CACHE") << "Saved " << data.size() << " bytes to " << pipelineCachePath;
+    LOGGER_ENDL;
+} catch (const std::exception &e) {
+    // Only the next startup is slower
+    logger->warn("PIPELINE_CACHE") << "Failed to save the pipeline cache: " << e.what();
+    LOGGER_ENDL;
+}
 
+void VulkanApplication::createPipelineLayout()
+{
+    DEBUG_FUNCTION
+    // The camera is read from the frame camera buffer, so it can be written after the recording
     std::vector<vk::DescriptorSetLayout> setLayout = {descriptorSetLayout, texturesSetLayout};
-    auto pipelineLayoutCreateInfo = vk_init::populateVkPipelineLayoutCreateInfo(setLayout, pipelinePushConstant);
+    auto pipelineLayoutCreateInfo = vk_init::populateVkPipelineLayoutCreateInfo(setLayout, {});
     pipelineLayout = device.createPipelineLayout(pipelineLayoutCreateInfo);
     mainDeletionQueue.push([&] { device.destroy(pipelineLayout); });
 }
 
-void VulkanApplication::createGraphicsPipeline()
+void VulkanApplication::createPipelineVariants()
 {
     DEBUG_FUNCTION
+    pipelineVariants.init(device,
+                          [this](const PipelineVariantCache::Key &key) { return buildGraphicsPipeline(key); });
+
+    // The startup waits for the current variant only. The variants reachable from the UI without recreating the
+    // swapchain follow it in the queue.
+    const auto currentKey = getPipelineKey();
+    const auto current = pipelineVariants.request(currentKey);
+    std::vector<PipelineVariantCache::Key> keys;
+    for (const auto polygonMode: {vk::PolygonMode::eFill, vk::PolygonMode::eLine}) {
+        for (const auto cullMode: {vk::CullModeFlagBits::eNone, vk::CullModeFlagBits::eBack,
+                                   vk::CullModeFlagBits::eFront, vk::CullModeFlagBits::eFrontAndBack}) {
+            auto key = currentKey;
+            key.polygonMode = polygonMode;
+            if (!bExtendedDynamicStateSupported) key.cullMode = cullMode;
+            if (key != currentKey && std::find(keys.begin(), keys.end(), key) == keys.end()) keys.push_back(key);
+        }
+    }
+    pipelineVariants.precompile(keys);
+    current.wait();
+}
+
+PipelineVariantCache::Key VulkanApplication::getPipelineKey() const noexcept
+{
+    return {
+        .polygonMode = creationParameters.polygonMode,
+        .cullMode = (bExtendedDynamicStateSupported) ? (vk::CullModeFlagBits::eNone) : (creationParameters.cullMode),
+        .msaaSample = creationParameters.msaaSample,
+        .colorFormat = swapchain.getSwapchainFormat(),
+    };
+}
+
+void VulkanApplication::updateGraphicsPipeline()
+{
+    const auto key = getPipelineKey();
+    if (graphicsPipeline && key == graphicsPipelineKey) return;
+
+    if (auto pipeline = pipelineVariants.tryGet(key)) {
+        graphicsPipeline = pipeline;
+        graphicsPipelineKey = key;
+    } else if (key.msaaSample != graphicsPipelineKey.msaaSample || key.colorFormat != graphicsPipelineKey.colorFormat) {
+        graphicsPipeline = VK_NULL_HANDLE;
+    }
+}
+
+vk::Pipeline VulkanApplication::buildGraphicsPipeline(const PipelineVariantCache::Key &key)
+{
+    PROFILE_SCOPE(getPipelineZoneName());
+    const auto start = std::chrono::steady_clock::now();
     auto vertShaderCode = vk_utils::readFile("shaders/default_triangle.vert.spv");
     auto fragShaderCode = vk_utils::readFile("shaders/default_triangle.frag.spv");
 
@@ -330,25 +541,25 @@ void VulkanApplication::createGraphicsPipeline()
     builder.vertexInputInfo = vk_init::populateVkPipelineVertexInputStateCreateInfo(binding, attribute);
     builder.inputAssembly =
         vk_init::populateVkPipelineInputAssemblyCreateInfo(vk::PrimitiveTopology::eTriangleList, VK_FALSE);
-    builder.multisampling = vk_init::populateVkPipelineMultisampleStateCreateInfo(creationParameters.msaaSample);
+    builder.multisampling = vk_init::populateVkPipelineMultisampleStateCreateInfo(key.msaaSample);
     builder.depthStencil = vk_init::populateVkPipelineDepthStencilStateCreateInfo();
-    builder.viewport.x = 0.0f;
-    builder.viewport.y = 0.0f;
-    builder.viewport.width = swapchain.getSwapchainExtent().width;
-    builder.viewport.height = swapchain.getSwapchainExtent().height;
-    builder.viewport.minDepth = 0.0f;
-    builder.viewport.maxDepth = 1.0f;
-    builder.scissor.offset = vk::Offset2D{0, 0};
-    builder.scissor.extent = swapchain.getSwapchainExtent();
+    // Set when recording, so the pipeline outlives a resize
+    builder.dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    if (bExtendedDynamicStateSupported) builder.dynamicStates.push_back(vk::DynamicState::eCullModeEXT);
     builder.colorBlendAttachment = vk_init::populateVkPipelineColorBlendAttachmentState();
-    builder.rasterizer = vk_init::populateVkPipelineRasterizationStateCreateInfo(creationParameters.polygonMode);
-    builder.rasterizer.cullMode = creationParameters.cullMode;
+    builder.rasterizer = vk_init::populateVkPipelineRasterizationStateCreateInfo(key.polygonMode);
+    builder.rasterizer.cullMode = key.cullMode;
     builder.rasterizer.frontFace = vk::FrontFace::eCounterClockwise;
-    graphicsPipeline = builder.build(device, renderPass);
+    // Compatible with every render pass of the same format and sample count
+    auto pipeline = builder.build(device, renderPass, pipelineCache);
 
     device.destroy(fragShaderModule);
     device.destroy(vertShaderModule);
-    swapchainDeletionQueue.push([&] { device.destroy(graphicsPipeline); });
+    const std::chrono::duration<float, std::milli> elapsed(std::chrono::steady_clock::now() - start);
+    logger->info("PIPELINE") << "Compiled a graphics pipeline variant in " << elapsed.count() << "ms ("
+                             << ((bPipelineCacheWarm) ? ("warm") : ("cold")) << " cache)";
+    LOGGER_ENDL;
+    return pipeline;
 }
 
 void VulkanApplication::createFramebuffers()
@@ -369,9 +580,7 @@ void VulkanApplication::createFramebuffers()
 
         swapChainFramebuffers.at(i) = device.createFramebuffer(framebufferInfo);
     }
-    swapchainDeletionQueue.push([&] {
-        for (auto &framebuffer: swapChainFramebuffers) { device.destroy(framebuffer); }
-    });
+    for (const auto &framebuffer: swapChainFramebuffers) { extentResources.push(0, framebuffer); }
 }
 
 void VulkanApplication::createCommandPool()
@@ -382,46 +591,114 @@ void VulkanApplication::createCommandPool()
         .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = indices.graphicsFamily.value(),
     };
-    commandPool = device.createCommandPool(poolInfo);
     uploadContext.commandPool = device.createCommandPool(poolInfo);
+
+    // The frame pools are reset as a whole once the frame timeline value is reached
+    vk::CommandPoolCreateInfo framePoolInfo{
+        .flags = vk::CommandPoolCreateFlagBits::eTransient,
+        .queueFamilyIndex = indices.graphicsFamily.value(),
+    };
+    for (auto &frame: frames) {
+        frame.commandPool = device.createCommandPool(framePoolInfo);
+        frame.recording.commandPools.resize(jobSystem.getNbOfThreads());
+        for (auto &pool: frame.recording.commandPools) { pool = device.createCommandPool(framePoolInfo); }
+        frame.recording.imguiPool = device.createCommandPool(framePoolInfo);
+    }
     mainDeletionQueue.push([&] {
         device.destroy(uploadContext.commandPool);
-        device.destroy(commandPool);
+        for (auto &frame: frames) {
+            device.destroy(frame.commandPool);
+            for (auto &pool: frame.recording.commandPools) { device.destroy(pool); }
+            device.destroy(frame.recording.imguiPool);
+        }
     });
 }
 
 void VulkanApplication::createCommandBuffers()
 {
     DEBUG_FUNCTION
-    vk::CommandBufferAllocateInfo allocInfo{
-        .commandPool = commandPool,
-        .level = vk::CommandBufferLevel::ePrimary,
-        .commandBufferCount = static_cast<uint32_t>(swapchain.nbOfImage()),
+    // Freed with their pools
+    for (auto &frame: frames) {
+        vk::CommandBufferAllocateInfo allocInfo{
+            .commandPool = frame.commandPool,
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+        };
+        frame.commandBuffer = device.allocateCommandBuffers(allocInfo).front();
+
+        auto &recording = frame.recording;
+        recording.drawCommands.resize(MAX_RENDER_PASS_PER_FRAME * recording.commandPools.size());
+        for (uint32_t i = 0; i < recording.commandPools.size(); i++) {
+            vk::CommandBufferAllocateInfo secondaryAllocInfo{
+                .commandPool = recording.commandPools.at(i),
+                .level = vk::CommandBufferLevel::eSecondary,
+                .commandBufferCount = MAX_RENDER_PASS_PER_FRAME,
+            };
+            auto buffers = device.allocateCommandBuffers(secondaryAllocInfo);
+            for (uint32_t pass = 0; pass < MAX_RENDER_PASS_PER_FRAME; pass++) {
+                recording.drawCommands.at(pass * recording.commandPools.size() + i) = buffers.at(pass);
+            }
+        }
+
+        vk::CommandBufferAllocateInfo imguiAllocInfo{
+            .commandPool = recording.imguiPool,
+            .level = vk::CommandBufferLevel::eSecondary,
+            .commandBufferCount = 1,
+        };
+        recording.imguiCommand = device.allocateCommandBuffers(imguiAllocInfo).front();
+    }
+}
+
+void VulkanApplication::createGPUProfiler()
+{
+    DEBUG_FUNCTION
+    auto indices = QueueFamilyIndices::findQueueFamilies(physical_device, surface);
+    gpuProfiler.init(device, physical_device, indices.graphicsFamily.value(), MAX_FRAME_FRAME_IN_FLIGHT);
+    mainDeletionQueue.push([&] { gpuProfiler.destroy(); });
+}
+
+void VulkanApplication::createStatisticsQueries()
+{
+    DEBUG_FUNCTION
+    if (!bPipelineStatisticsSupported) return;
+
+    vk::QueryPoolCreateInfo poolInfo{
+        .queryType = vk::QueryType::ePipelineStatistics,
+        .queryCount = 1,
+        .pipelineStatistics = pipelineStatistics,
     };
-    commandBuffers = device.allocateCommandBuffers(allocInfo);
-    swapchainDeletionQueue.push([&] { device.free(commandPool, commandBuffers); });
+    for (auto &f: frames) {
+        f.statisticsPool = device.createQueryPool(poolInfo);
+        mainDeletionQueue.push([&] { device.destroy(f.statisticsPool); });
+    }
 }
 
 void VulkanApplication::createSyncObjects()
 {
     DEBUG_FUNCTION
     vk::SemaphoreCreateInfo semaphoreInfo{};
-    vk::FenceCreateInfo fenceInfo{
-        .flags = vk::FenceCreateFlagBits::eSignaled,
+    vk::SemaphoreTypeCreateInfo timelineInfo{
+        .semaphoreType = vk::SemaphoreType::eTimeline,
+        .initialValue = 0,
+    };
+    vk::SemaphoreCreateInfo timelineSemaphoreInfo{
+        .pNext = &timelineInfo,
     };
-    vk::FenceCreateInfo uploadFenceInfo{};
 
-    uploadContext.uploadFence = device.createFence(uploadFenceInfo);
+    graphicsTimeline.semaphore = device.createSemaphore(timelineSemaphoreInfo);
+    graphicsTimeline.value = 0;
     for (auto &f: frames) {
         f.imageAvailableSemaphore = device.createSemaphore(semaphoreInfo);
         f.renderFinishedSemaphore = device.createSemaphore(semaphoreInfo);
-        f.inFlightFences = device.createFence(fenceInfo);
+        f.timelineValue = 0;
     }
 
+    deferredDeletionQueue.init(device, allocator);
+    extentResources.init(device, allocator);
     mainDeletionQueue.push([&] {
-        device.destroy(uploadContext.uploadFence);
+        deferredDeletionQueue.flush();
+        device.destroy(graphicsTimeline.semaphore);
         for (auto &f: frames) {
-            device.destroy(f.inFlightFences);
             device.destroy(f.renderFinishedSemaphore);
             device.destroy(f.imageAvailableSemaphore);
         }
@@ -445,8 +722,24 @@ void VulkanApplication::createDescriptorSetLayout()
         .stageFlags = vk::ShaderStageFlagBits::eFragment,
         .pImmutableSamplers = nullptr,
     };
+    vk::DescriptorSetLayoutBinding instanceBinding{
+        .binding = 2,
+        .descriptorType = vk::DescriptorType::eStorageBuffer,
+        .descriptorCount = 1,
+        .stageFlags = vk::ShaderStageFlagBits::eVertex,
+        .pImmutableSamplers = nullptr,
+    };
+
+    vk::DescriptorSetLayoutBinding cameraBinding{
+        .binding = 3,
+        .descriptorType = vk::DescriptorType::eUniformBuffer,
+        .descriptorCount = 1,
+        .stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+        .pImmutableSamplers = nullptr,
+    };
 
-    std::vector<vk::DescriptorSetLayoutBinding> bindings = {uboLayoutBinding, materialBinding};
+    std::vector<vk::DescriptorSetLayoutBinding> bindings = {uboLayoutBinding, materialBinding, instanceBinding,
+                                                            cameraBinding};
     vk::DescriptorSetLayoutCreateInfo layoutInfo{
         .bindingCount = static_cast<uint32_t>(bindings.size()),
         .pBindings = bindings.data(),
@@ -485,16 +778,39 @@ void VulkanApplication::createTextureDescriptorSetLayout()
 void VulkanApplication::createUniformBuffers()
 {
     DEBUG_FUNCTION
+    const uint32_t maxObjects = creationParameters.maxObjects;
     for (auto &f: frames) {
-        f.data.uniformBuffers = createBuffer(sizeof(gpuObject::UniformBufferObject) * MAX_OBJECT,
+        f.data.uniformBuffers = createBuffer(sizeof(gpuObject::UniformBufferObject) * maxObjects,
                                              vk::BufferUsageFlagBits::eStorageBuffer, vma::MemoryUsage::eCpuToGpu);
         f.data.materialBuffer = createBuffer(sizeof(gpuObject::Material) * MAX_MATERIALS,
                                              vk::BufferUsageFlagBits::eStorageBuffer, vma::MemoryUsage::eCpuToGpu);
+        // Early and late pass instances are stored one after the other
+        f.data.instanceBuffer = createBuffer(sizeof(uint32_t) * maxObjects * 2, vk::BufferUsageFlagBits::eStorageBuffer,
+                                             vma::MemoryUsage::eCpuToGpu);
+        f.data.objectBatchBuffer = createBuffer(sizeof(uint32_t) * maxObjects, vk::BufferUsageFlagBits::eStorageBuffer,
+                                                vma::MemoryUsage::eCpuToGpu);
+        f.data.boundsBuffer = createBuffer(sizeof(gpuObject::Bounds) * maxObjects,
+                                           vk::BufferUsageFlagBits::eStorageBuffer, vma::MemoryUsage::eCpuToGpu);
+        f.data.cullingStatsBuffer = createBuffer(sizeof(gpuObject::CullingStats),
+                                                 vk::BufferUsageFlagBits::eStorageBuffer |
+                                                     vk::BufferUsageFlagBits::eTransferDst,
+                                                 vma::MemoryUsage::eGpuToCpu);
+        f.bCullingStatsWritten = false;
+        f.data.cameraBuffer = createBuffer(sizeof(Camera::GPUCameraData), vk::BufferUsageFlagBits::eUniformBuffer,
+                                           vma::MemoryUsage::eCpuToGpu);
+        f.data.camera = static_cast<Camera::GPUCameraData *>(allocator.mapMemory(f.data.cameraBuffer.memory));
     }
     swapchainDeletionQueue.push([&] {
         for (auto &f: frames) {
+            allocator.unmapMemory(f.data.cameraBuffer.memory);
+            allocator.destroyBuffer(f.data.cameraBuffer.buffer, f.data.cameraBuffer.memory);
+            f.data.camera = nullptr;
             allocator.destroyBuffer(f.data.uniformBuffers.buffer, f.data.uniformBuffers.memory);
             allocator.destroyBuffer(f.data.materialBuffer.buffer, f.data.materialBuffer.memory);
+            allocator.destroyBuffer(f.data.instanceBuffer.buffer, f.data.instanceBuffer.memory);
+            allocator.destroyBuffer(f.data.objectBatchBuffer.buffer, f.data.objectBatchBuffer.memory);
+            allocator.destroyBuffer(f.data.boundsBuffer.buffer, f.data.boundsBuffer.memory);
+            allocator.destroyBuffer(f.data.cullingStatsBuffer.buffer, f.data.cullingStatsBuffer.memory);
         }
     });
 }
@@ -502,15 +818,24 @@ void VulkanApplication::createUniformBuffers()
 void VulkanApplication::createIndirectBuffer()
 {
     DEBUG_FUNCTION
+    // At most one command per object
+    const uint32_t commandsSize = sizeof(vk::DrawIndexedIndirectCommand) * creationParameters.maxObjects;
     for (auto &f: frames) {
         f.indirectBuffer =
-            this->createBuffer(sizeof(vk::DrawIndexedIndirectCommand) * MAX_OBJECT,
+            this->createBuffer(commandsSize,
                                vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer |
                                    vk::BufferUsageFlagBits::eIndirectBuffer,
                                vma::MemoryUsage::eCpuToGpu);
+        f.lateIndirectBuffer = this->createBuffer(commandsSize,
+                                                  vk::BufferUsageFlagBits::eStorageBuffer |
+                                                      vk::BufferUsageFlagBits::eIndirectBuffer,
+                                                  vma::MemoryUsage::eCpuToGpu);
     }
     mainDeletionQueue.push([&] {
-        for (auto &f: frames) { allocator.destroyBuffer(f.indirectBuffer.buffer, f.indirectBuffer.memory); }
+        for (auto &f: frames) {
+            allocator.destroyBuffer(f.indirectBuffer.buffer, f.indirectBuffer.memory);
+            allocator.destroyBuffer(f.lateIndirectBuffer.buffer, f.lateIndirectBuffer.memory);
+        }
     });
 }
 void VulkanApplication::createDescriptorPool()
@@ -552,13 +877,23 @@ void VulkanApplication::createDescriptorSets()
         vk::DescriptorBufferInfo bufferInfo{
             .buffer = f.data.uniformBuffers.buffer,
             .offset = 0,
-            .range = sizeof(gpuObject::UniformBufferObject) * MAX_OBJECT,
+            .range = VK_WHOLE_SIZE,
         };
         vk::DescriptorBufferInfo materialInfo{
             .buffer = f.data.materialBuffer.buffer,
             .offset = 0,
             .range = sizeof(gpuObject::Material) * MAX_MATERIALS,
         };
+        vk::DescriptorBufferInfo instanceInfo{
+            .buffer = f.data.instanceBuffer.buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        };
+        vk::DescriptorBufferInfo cameraInfo{
+            .buffer = f.data.cameraBuffer.buffer,
+            .offset = 0,
+            .range = sizeof(Camera::GPUCameraData),
+        };
         std::vector<vk::WriteDescriptorSet> descriptorWrites{
             {
                 .dstSet = f.data.objectDescriptor,
@@ -576,8 +911,25 @@ void VulkanApplication::createDescriptorSets()
                 .descriptorType = vk::DescriptorType::eStorageBuffer,
                 .pBufferInfo = &materialInfo,
             },
+            {
+                .dstSet = f.data.objectDescriptor,
+                .dstBinding = 2,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &instanceInfo,
+            },
+            {
+                .dstSet = f.data.objectDescriptor,
+                .dstBinding = 3,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eUniformBuffer,
+                .pBufferInfo = &cameraInfo,
+            },
         };
         device.updateDescriptorSets(descriptorWrites, 0);
+        descriptorWriteCount += std::size(descriptorWrites);
     }
 }
 
@@ -615,6 +967,7 @@ void VulkanApplication::createTextureDescriptorSets()
         .pImageInfo = imagesInfos.data(),
     };
     device.updateDescriptorSets(descriptorWrite, 0);
+    descriptorWriteCount += 1;
 }
 
 void VulkanApplication::createTextureSampler()
@@ -646,9 +999,8 @@ void VulkanApplication::createTextureSampler()
 void VulkanApplication::createDepthResources()
 {
     DEBUG_FUNCTION
-    vk::Format depthFormat = vk_utils::findSupportedFormat(
-        physical_device, {vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint},
-        vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+    if (creationParameters.bOcclusionCulling) usage |= vk::ImageUsageFlagBits::eSampled;
 
     vk::ImageCreateInfo imageInfo{
         .imageType = vk::ImageType::e2D,
@@ -658,7 +1010,7 @@ void VulkanApplication::createDepthResources()
         .arrayLayers = 1,
         .samples = creationParameters.msaaSample,
         .tiling = vk::ImageTiling::eOptimal,
-        .usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+        .usage = usage,
         .sharingMode = vk::SharingMode::eExclusive,
         .initialLayout = vk::ImageLayout::eUndefined,
     };
@@ -670,17 +1022,19 @@ void VulkanApplication::createDepthResources()
     createInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
     depthResources.imageView = device.createImageView(createInfo);
 
-    transitionImageLayout(depthResources.image, depthFormat, vk::ImageLayout::eUndefined,
-                          vk::ImageLayout::eDepthStencilAttachmentOptimal);
-    swapchainDeletionQueue.push([&] {
-        device.destroy(depthResources.imageView);
-        allocator.destroyImage(depthResources.image, depthResources.memory);
-    });
+    // No layout transition: the first render pass of a frame starts the depth from eUndefined, so the resize does
+    // not wait for the queue to be drained
+    extentResources.push(0, depthResources.imageView);
+    extentResources.push(0, depthResources.image, depthResources.memory);
 }
 
 void VulkanApplication::createColorResources()
 {
     DEBUG_FUNCTION
+    // The color attachment is stored between the two passes of the occlusion culling, so it can't be transient
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+    if (!creationParameters.bOcclusionCulling) usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+
     vk::ImageCreateInfo imageInfo{
         .imageType = vk::ImageType::e2D,
         .format = swapchain.getSwapchainFormat(),
@@ -689,7 +1043,7 @@ void VulkanApplication::createColorResources()
         .arrayLayers = 1,
         .samples = creationParameters.msaaSample,
         .tiling = vk::ImageTiling::eOptimal,
-        .usage = vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment,
+        .usage = usage,
         .sharingMode = vk::SharingMode::eExclusive,
         .initialLayout = vk::ImageLayout::eUndefined,
     };
@@ -701,10 +1055,8 @@ void VulkanApplication::createColorResources()
     createInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
     colorImage.imageView = device.createImageView(createInfo);
 
-    swapchainDeletionQueue.push([&] {
-        device.destroy(colorImage.imageView);
-        allocator.destroyImage(colorImage.image, colorImage.memory);
-    });
+    extentResources.push(0, colorImage.imageView);
+    extentResources.push(0, colorImage.image, colorImage.memory);
 }
 
 void VulkanApplication::createImgui()
@@ -744,10 +1096,10 @@ void VulkanApplication::createImgui()
     init_info.Device = device;
     init_info.QueueFamily = indices.graphicsFamily.value();
     init_info.Queue = graphicsQueue;
-    init_info.PipelineCache = VK_NULL_HANDLE;
+    init_info.PipelineCache = pipelineCache;
     init_info.DescriptorPool = imguiPool;
-    init_info.MinImageCount = swapchain.nbOfImage();
-    init_info.ImageCount = swapchain.nbOfImage();
+    init_info.MinImageCount = getImguiImageCount();
+    init_info.ImageCount = getImguiImageCount();
     init_info.MSAASamples = static_cast<VkSampleCountFlagBits>(creationParameters.msaaSample);
     init_info.CheckVkResultFn = vk_utils::vk_try;
 
@@ -763,25 +1115,41 @@ void VulkanApplication::createImgui()
     });
 }
 
-void VulkanApplication::recreateSwapchain()
+void VulkanApplication::waitForValidExtent()
 {
-    DEBUG_FUNCTION
     int width = 0, height = 0;
-    glfwGetFramebufferSize(window.getWindow(), &width, &height);
-    while (width == 0 || height == 0) {
+    while (!window.isHeadless() && (width == 0 || height == 0)) {
         glfwGetFramebufferSize(window.getWindow(), &width, &height);
-        glfwWaitEvents();
+        if (width == 0 || height == 0) glfwWaitEvents();
     }
+}
+
+void VulkanApplication::recreateSwapchain()
+{
+    DEBUG_FUNCTION
+    PROFILE_FUNCTION;
+    waitForValidExtent();
 
     logger->info("Swapchain") << "Recreaing swapchain...";
     LOGGER_ENDL;
 
     device.waitIdle();
+    pipelineVariants.wait();
+    extentResources.flush();
     swapchainDeletionQueue.flush();
+    // Every frame is idle, so the number of frames in flight can change
+    currentFrame %= creationParameters.framesInFlight;
 
-    swapchain.recreate(window, physical_device, device, surface);
+    if (swapchain.isOffscreen()) {
+        swapchain.destroy();
+        swapchain.initOffscreen(window.getSize(), MAX_FRAME_FRAME_IN_FLIGHT, device, allocator);
+    } else {
+        swapchain.recreate(window, physical_device, device, surface, creationParameters);
+    }
     createRenderPass();
-    createGraphicsPipeline();
+    // The device is idle already, so the frame does not start without its variant when the format changes
+    pipelineVariants.request(getPipelineKey()).wait();
+    updateGraphicsPipeline();
     createColorResources();
     createDepthResources();
     createFramebuffers();
@@ -789,11 +1157,44 @@ void VulkanApplication::recreateSwapchain()
     createDescriptorPool();
     createDescriptorSets();
     createTextureDescriptorSets();
-    createCommandBuffers();
-    createImgui();
+    createDepthPyramid();
+    createOcclusionCullingDescriptors();
+    if (!window.isHeadless()) createImgui();
     logger->info("Swapchain") << "Swapchain recreation complete... { height = " << swapchain.getSwapchainExtent().height
                               << ", width = " << swapchain.getSwapchainExtent().width
-                              << ", number = " << swapchain.nbOfImage() << " }";
+                              << ", number = " << swapchain.nbOfImage()
+                              << ", present mode = " << vk::to_string(swapchain.getPresentMode()) << " }";
+    LOGGER_ENDL;
+    if (!window.isHeadless()) ImGui_ImplVulkan_SetMinImageCount(getImguiImageCount());
+    onFrameBuffersRecreated();
+}
+
+void VulkanApplication::resizeSwapchain()
+{
+    DEBUG_FUNCTION
+    PROFILE_FUNCTION;
+    // The offscreen images never go out of date
+    if (swapchain.isOffscreen()) return recreateSwapchain();
+    waitForValidExtent();
+
+    const vk::Format previousFormat = swapchain.getSwapchainFormat();
+    const uint32_t previousImageCount = getImguiImageCount();
+    // The frames in flight still use the previous resources, they are destroyed once the GPU is done with them
+    extentResources.moveTo(deferredDeletionQueue, graphicsTimeline.value);
+    swapchain.resize(window, physical_device, device, surface, creationParameters, deferredDeletionQueue,
+                     graphicsTimeline.value);
+    // The render passes and the pipelines are created for the format
+    if (swapchain.getSwapchainFormat() != previousFormat) return recreateSwapchain();
+
+    createColorResources();
+    createDepthResources();
+    createFramebuffers();
+    createDepthPyramid();
+    createOcclusionCullingDescriptors();
+    if (!window.isHeadless() && getImguiImageCount() != previousImageCount) {
+        ImGui_ImplVulkan_SetMinImageCount(getImguiImageCount());
+    }
+    logger->info("Swapchain") << "Swapchain resized { height = " << swapchain.getSwapchainExtent().height
+                              << ", width = " << swapchain.getSwapchainExtent().width << " }";
     LOGGER_ENDL;
-    ImGui_ImplVulkan_SetMinImageCount(swapchain.nbOfImage());
 }
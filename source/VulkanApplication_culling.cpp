@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <vk_mem_alloc.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include "DebugMacros.hpp"
+#include "Profiler.hpp"
+#include "VulkanApplication.hpp"
+#include "types/vk_types.hpp"
+#include "vk_init.hpp"
+#include "vk_utils.hpp"
+
+struct DepthReduceConstants {
+    int32_t inputWidth;
+    int32_t inputHeight;
+    int32_t outputWidth;
+    int32_t outputHeight;
+    int32_t samples;
+};
+
+struct OcclusionCullingConstants {
+    glm::mat4 viewproj;
+    glm::vec2 pyramidSize;
+    uint32_t objectCount;
+    uint32_t phase;
+};
+
+// Every binding of the culling set is a storage buffer, except the depth pyramid
+static constexpr uint32_t pyramidBinding = 5;
+
+static uint32_t previousPow2(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value) result *= 2;
+    return result;
+}
+
+static constexpr uint32_t dispatchSize(uint32_t size, uint32_t groupSize) { return (size + groupSize - 1) / groupSize; }
+
+void VulkanApplication::createOcclusionCullingLayouts()
+{
+    DEBUG_FUNCTION
+    std::array<vk::DescriptorSetLayoutBinding, 2> reduceBindings{{
+        {
+            .binding = 0,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+        {
+            .binding = 1,
+            .descriptorType = vk::DescriptorType::eStorageImage,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        },
+    }};
+    vk::DescriptorSetLayoutCreateInfo reduceInfo{
+        .bindingCount = static_cast<uint32_t>(reduceBindings.size()),
+        .pBindings = reduceBindings.data(),
+    };
+    occlusion.reduceSetLayout = device.createDescriptorSetLayout(reduceInfo);
+
+    std::array<vk::DescriptorSetLayoutBinding, 8> cullBindings;
+    for (uint32_t i = 0; i < cullBindings.size(); i++) {
+        cullBindings.at(i) = {
+            .binding = i,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+        };
+    }
+    cullBindings.at(pyramidBinding).descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    vk::DescriptorSetLayoutCreateInfo cullInfo{
+        .bindingCount = static_cast<uint32_t>(cullBindings.size()),
+        .pBindings = cullBindings.data(),
+    };
+    occlusion.cullSetLayout = device.createDescriptorSetLayout(cullInfo);
+
+    std::vector<vk::PushConstantRange> reducePush = {
+        vk_init::populateVkPushConstantRange(vk::ShaderStageFlagBits::eCompute, sizeof(DepthReduceConstants))};
+    std::vector<vk::DescriptorSetLayout> reduceSetLayouts = {occlusion.reduceSetLayout};
+    auto reduceLayoutInfo = vk_init::populateVkPipelineLayoutCreateInfo(reduceSetLayouts, reducePush);
+    occlusion.reduceLayout = device.createPipelineLayout(reduceLayoutInfo);
+
+    std::vector<vk::PushConstantRange> cullPush = {
+        vk_init::populateVkPushConstantRange(vk::ShaderStageFlagBits::eCompute, sizeof(OcclusionCullingConstants))};
+    std::vector<vk::DescriptorSetLayout> cullSetLayouts = {occlusion.cullSetLayout};
+    auto cullLayoutInfo = vk_init::populateVkPipelineLayoutCreateInfo(cullSetLayouts, cullPush);
+    occlusion.cullLayout = device.createPipelineLayout(cullLayoutInfo);
+
+    vk::SamplerCreateInfo samplerInfo{
+        .magFilter = vk::Filter::eNearest,
+        .minFilter = vk::Filter::eNearest,
+        .mipmapMode = vk::SamplerMipmapMode::eNearest,
+        .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+    };
+    occlusion.pyramidSampler = device.createSampler(samplerInfo);
+
+    const uint32_t visibilitySize = sizeof(uint32_t) * creationParameters.maxObjects;
+    occlusion.visibilityBuffer =
+        createBuffer(visibilitySize, vk::BufferUsageFlagBits::eStorageBuffer, vma::MemoryUsage::eCpuToGpu);
+    void *visibilityData = allocator.mapMemory(occlusion.visibilityBuffer.memory);
+    std::memset(visibilityData, 0, visibilitySize);
+    allocator.unmapMemory(occlusion.visibilityBuffer.memory);
+
+    mainDeletionQueue.push([&] {
+        allocator.destroyBuffer(occlusion.visibilityBuffer.buffer, occlusion.visibilityBuffer.memory);
+        device.destroy(occlusion.pyramidSampler);
+        device.destroy(occlusion.cullLayout);
+        device.destroy(occlusion.reduceLayout);
+        device.destroy(occlusion.cullSetLayout);
+        device.destroy(occlusion.reduceSetLayout);
+    });
+}
+
+void VulkanApplication::createOcclusionCullingPipelines()
+{
+    DEBUG_FUNCTION
+    auto createComputePipeline = [&](const std::string &path, vk::PipelineLayout &layout) {
+        PROFILE_SCOPE(getPipelineZoneName());
+        auto shaderCode = vk_utils::readFile(path);
+        auto shaderModule = vk_utils::createShaderModule(device, shaderCode);
+
+        vk::ComputePipelineCreateInfo pipelineInfo{
+            .stage = vk_init::populateVkPipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eCompute, shaderModule),
+            .layout = layout,
+        };
+        auto [result, pipeline] = device.createComputePipeline(pipelineCache, pipelineInfo);
+        device.destroy(shaderModule);
+        VK_TRY(result);
+        return pipeline;
+    };
+
+    occlusion.reducePipeline = createComputePipeline("shaders/depth_reduce.comp.spv", occlusion.reduceLayout);
+    occlusion.resolvePipeline = createComputePipeline("shaders/depth_resolve.comp.spv", occlusion.reduceLayout);
+    occlusion.cullPipeline = createComputePipeline("shaders/occlusion_cull.comp.spv", occlusion.cullLayout);
+    mainDeletionQueue.push([&] {
+        device.destroy(occlusion.cullPipeline);
+        device.destroy(occlusion.resolvePipeline);
+        device.destroy(occlusion.reducePipeline);
+    });
+}
+
+void VulkanApplication::createDepthPyramid()
+{
+    DEBUG_FUNCTION
+    if (!creationParameters.bOcclusionCulling) return;
+
+    occlusion.pyramidExtent = vk::Extent2D{
+        .width = previousPow2(swapchain.getSwapchainExtent().width),
+        .height = previousPow2(swapchain.getSwapchainExtent().height),
+    };
+    occlusion.pyramidLevels =
+        static_cast<uint32_t>(std::floor(std::log2(std::max(occlusion.pyramidExtent.width,
+                                                              occlusion.pyramidExtent.height)))) +
+        1;
+
+    vk::ImageCreateInfo imageInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = vk::Format::eR32Sfloat,
+        .extent =
+            {
+                .width = occlusion.pyramidExtent.width,
+                .height = occlusion.pyramidExtent.height,
+                .depth = 1,
+            },
+        .mipLevels = occlusion.pyramidLevels,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+    vma::AllocationCreateInfo allocInfo{};
+    allocInfo.usage = vma::MemoryUsage::eGpuOnly;
+    std::tie(occlusion.depthPyramid.image, occlusion.depthPyramid.memory) =
+        allocator.createImage(imageInfo, allocInfo);
+
+    auto createInfo = vk_init::populateVkImageViewCreateInfo(occlusion.depthPyramid.image, vk::Format::eR32Sfloat,
+                                                             occlusion.pyramidLevels);
+    occlusion.depthPyramid.imageView = device.createImageView(createInfo);
+
+    occlusion.pyramidMips.resize(occlusion.pyramidLevels);
+    for (uint32_t i = 0; i < occlusion.pyramidLevels; i++) {
+        auto mipInfo = vk_init::populateVkImageViewCreateInfo(occlusion.depthPyramid.image, vk::Format::eR32Sfloat);
+        mipInfo.subresourceRange.baseMipLevel = i;
+        occlusion.pyramidMips.at(i) = device.createImageView(mipInfo);
+    }
+
+    for (const auto &view: occlusion.pyramidMips) { extentResources.push(0, view); }
+    extentResources.push(0, occlusion.depthPyramid.imageView);
+    extentResources.push(0, occlusion.depthPyramid.image, occlusion.depthPyramid.memory);
+}
+
+void VulkanApplication::createOcclusionCullingDescriptors()
+{
+    DEBUG_FUNCTION
+    if (!creationParameters.bOcclusionCulling) return;
+
+    vk::DescriptorPoolSize poolSize[] = {
+        {
+            .type = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = occlusion.pyramidLevels + MAX_FRAME_FRAME_IN_FLIGHT,
+        },
+        {
+            .type = vk::DescriptorType::eStorageImage,
+            .descriptorCount = occlusion.pyramidLevels,
+        },
+        {
+            .type = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 7 * MAX_FRAME_FRAME_IN_FLIGHT,
+        },
+    };
+    vk::DescriptorPoolCreateInfo poolInfo{
+        .maxSets = occlusion.pyramidLevels + MAX_FRAME_FRAME_IN_FLIGHT,
+        .poolSizeCount = std::size(poolSize),
+        .pPoolSizes = poolSize,
+    };
+    occlusion.descriptorPool = device.createDescriptorPool(poolInfo);
+    extentResources.push(0, occlusion.descriptorPool);
+
+    std::vector<vk::DescriptorSetLayout> reduceLayouts(occlusion.pyramidLevels, occlusion.reduceSetLayout);
+    vk::DescriptorSetAllocateInfo reduceAllocInfo{
+        .descriptorPool = occlusion.descriptorPool,
+        .descriptorSetCount = static_cast<uint32_t>(reduceLayouts.size()),
+        .pSetLayouts = reduceLayouts.data(),
+    };
+    occlusion.reduceSets = device.allocateDescriptorSets(reduceAllocInfo);
+
+    for (uint32_t i = 0; i < occlusion.pyramidLevels; i++) {
+        // The first level is built from the depth buffer, the others from the previous level
+        vk::DescriptorImageInfo inputInfo{
+            .sampler = occlusion.pyramidSampler,
+            .imageView = (i == 0) ? (depthResources.imageView) : (occlusion.pyramidMips.at(i - 1)),
+            .imageLayout = (i == 0) ? (vk::ImageLayout::eShaderReadOnlyOptimal) : (vk::ImageLayout::eGeneral),
+        };
+        vk::DescriptorImageInfo outputInfo{
+            .imageView = occlusion.pyramidMips.at(i),
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+        std::array<vk::WriteDescriptorSet, 2> descriptorWrites{{
+            {
+                .dstSet = occlusion.reduceSets.at(i),
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+                .pImageInfo = &inputInfo,
+            },
+            {
+                .dstSet = occlusion.reduceSets.at(i),
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageImage,
+                .pImageInfo = &outputInfo,
+            },
+        }};
+        device.updateDescriptorSets(descriptorWrites, 0);
+        descriptorWriteCount += std::size(descriptorWrites);
+    }
+
+    for (auto &f: frames) {
+        vk::DescriptorSetAllocateInfo allocInfo{
+            .descriptorPool = occlusion.descriptorPool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &occlusion.cullSetLayout,
+        };
+        f.data.cullingDescriptor = device.allocateDescriptorSets(allocInfo).front();
+
+        // The buffers are sized from the object capacity
+        std::array<vk::DescriptorBufferInfo, 8> bufferInfos{{
+            {.buffer = f.data.boundsBuffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = f.indirectBuffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = f.lateIndirectBuffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = occlusion.visibilityBuffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = f.data.cullingStatsBuffer.buffer, .offset = 0, .range = sizeof(gpuObject::CullingStats)},
+            {},
+            {.buffer = f.data.objectBatchBuffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = f.data.instanceBuffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        }};
+        vk::DescriptorImageInfo pyramidInfo{
+            .sampler = occlusion.pyramidSampler,
+            .imageView = occlusion.depthPyramid.imageView,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        };
+
+        // One write per binding, the pyramid binding included
+        std::array<vk::WriteDescriptorSet, std::tuple_size_v<decltype(bufferInfos)>> descriptorWrites;
+        for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+            descriptorWrites.at(i) = {
+                .dstSet = f.data.cullingDescriptor,
+                .dstBinding = i,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eStorageBuffer,
+                .pBufferInfo = &bufferInfos.at(i),
+            };
+        }
+        descriptorWrites.at(pyramidBinding) = {
+            .dstSet = f.data.cullingDescriptor,
+            .dstBinding = pyramidBinding,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo = &pyramidInfo,
+        };
+        device.updateDescriptorSets(descriptorWrites, 0);
+        descriptorWriteCount += std::size(descriptorWrites);
+    }
+}
+
+void VulkanApplication::recordOcclusionCulling(vk::CommandBuffer &cmd, Frame &frame, const glm::mat4 &viewproj,
+                                               CullingPhase phase, uint32_t objectCount)
+{
+    if (phase == CullingPhase::Early) {
+        cmd.fillBuffer(frame.data.cullingStatsBuffer.buffer, 0, sizeof(gpuObject::CullingStats), 0);
+        vk::MemoryBarrier clearBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+        };
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {},
+                            clearBarrier, nullptr, nullptr);
+    }
+
+    OcclusionCullingConstants constants{
+        .viewproj = viewproj,
+        .pyramidSize = glm::vec2(occlusion.pyramidExtent.width, occlusion.pyramidExtent.height),
+        .objectCount = objectCount,
+        .phase = static_cast<uint32_t>(phase),
+    };
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, occlusion.cullPipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, occlusion.cullLayout, 0, frame.data.cullingDescriptor,
+                           nullptr);
+    cmd.pushConstants<OcclusionCullingConstants>(occlusion.cullLayout, vk::ShaderStageFlagBits::eCompute, 0,
+                                                 constants);
+    cmd.dispatch(dispatchSize(objectCount, 64), 1, 1);
+    frame.stats.pipelineBinds += 1;
+    frame.stats.descriptorBinds += 1;
+    frame.stats.dispatches += 1;
+
+    vk::MemoryBarrier commandBarrier{
+        .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+        .dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead,
+    };
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader |
+                            vk::PipelineStageFlagBits::eComputeShader,
+                        {}, commandBarrier, nullptr, nullptr);
+
+    if (phase == CullingPhase::Late) {
+        // The statistics are read back by the host once the frame is complete
+        vk::MemoryBarrier statsBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eHostRead,
+        };
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, {},
+                            statsBarrier, nullptr, nullptr);
+    }
+}
+
+void VulkanApplication::recordDepthPyramid(vk::CommandBuffer &cmd, RenderStats &stats)
+{
+    vk::ImageAspectFlags depthAspect = vk::ImageAspectFlagBits::eDepth;
+    if (vk_utils::hasStencilComponent(depthFormat)) depthAspect |= vk::ImageAspectFlagBits::eStencil;
+
+    std::array<vk::ImageMemoryBarrier, 2> readBarriers{{
+        {
+            .srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+            .oldLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+            .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = depthResources.image,
+            .subresourceRange =
+                {
+                    .aspectMask = depthAspect,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+        },
+        {
+            // Previous content is not needed, the whole pyramid is rebuilt
+            .srcAccessMask = vk::AccessFlagBits::eShaderRead,
+            .dstAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .oldLayout = vk::ImageLayout::eUndefined,
+            .newLayout = vk::ImageLayout::eGeneral,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = occlusion.depthPyramid.image,
+            .subresourceRange =
+                {
+                    .aspectMask = vk::ImageAspectFlagBits::eColor,
+                    .baseMipLevel = 0,
+                    .levelCount = occlusion.pyramidLevels,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+        },
+    }};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, readBarriers);
+
+    const bool bMultisampled = creationParameters.msaaSample != vk::SampleCountFlagBits::e1;
+    vk::Extent2D inputExtent = swapchain.getSwapchainExtent();
+    for (uint32_t i = 0; i < occlusion.pyramidLevels; i++) {
+        const vk::Extent2D outputExtent{
+            .width = std::max(occlusion.pyramidExtent.width >> i, 1u),
+            .height = std::max(occlusion.pyramidExtent.height >> i, 1u),
+        };
+        DepthReduceConstants constants{
+            .inputWidth = static_cast<int32_t>(inputExtent.width),
+            .inputHeight = static_cast<int32_t>(inputExtent.height),
+            .outputWidth = static_cast<int32_t>(outputExtent.width),
+            .outputHeight = static_cast<int32_t>(outputExtent.height),
+            .samples = static_cast<int32_t>(creationParameters.msaaSample),
+        };
+
+        // The multisampled depth buffer is resolved to a single sample while building the first level
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute,
+                         (i == 0 && bMultisampled) ? (occlusion.resolvePipeline) : (occlusion.reducePipeline));
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, occlusion.reduceLayout, 0, occlusion.reduceSets.at(i),
+                               nullptr);
+        cmd.pushConstants<DepthReduceConstants>(occlusion.reduceLayout, vk::ShaderStageFlagBits::eCompute, 0,
+                                                constants);
+        cmd.dispatch(dispatchSize(outputExtent.width, 8), dispatchSize(outputExtent.height, 8), 1);
+        stats.pipelineBinds += 1;
+        stats.descriptorBinds += 1;
+        stats.dispatches += 1;
+
+        vk::MemoryBarrier levelBarrier{
+            .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+            .dstAccessMask = vk::AccessFlagBits::eShaderRead,
+        };
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {},
+                            levelBarrier, nullptr, nullptr);
+        inputExtent = outputExtent;
+    }
+
+    vk::ImageMemoryBarrier writeBarrier{
+        .srcAccessMask = vk::AccessFlagBits::eShaderRead,
+        .dstAccessMask =
+            vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        .oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        .newLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = depthResources.image,
+        .subresourceRange = readBarriers.at(0).subresourceRange,
+    };
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eEarlyFragmentTests, {},
+                        nullptr, nullptr, writeBarrier);
+}
@@ -66,22 +66,38 @@ void VulkanApplication::immediateCommand(std::function<void(vk::CommandBuffer &)
     function(cmd);
     cmd.end();
 
+    const uint64_t signalValue = graphicsTimeline.value + 1;
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &signalValue,
+    };
     vk::SubmitInfo submit{
+        .pNext = &timelineInfo,
         .waitSemaphoreCount = 0,
         .pWaitSemaphores = nullptr,
         .pWaitDstStageMask = nullptr,
         .commandBufferCount = 1,
         .pCommandBuffers = &cmd,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &graphicsTimeline.semaphore,
     };
 
-    graphicsQueue.submit(submit, uploadContext.uploadFence);
-    VK_TRY(device.waitForFences(uploadContext.uploadFence, VK_TRUE, UINT64_MAX));
-    device.resetFences(uploadContext.uploadFence);
+    graphicsQueue.submit(submit);
+    graphicsTimeline.value = signalValue;
+    waitTimeline(signalValue);
     device.resetCommandPool(uploadContext.commandPool);
 }
 
+void VulkanApplication::waitTimeline(uint64_t value)
+{
+    vk::SemaphoreWaitInfo waitInfo{
+        .semaphoreCount = 1,
+        .pSemaphores = &graphicsTimeline.semaphore,
+        .pValues = &value,
+    };
+    VK_TRY(device.waitSemaphores(waitInfo, UINT64_MAX));
+}
+
 void VulkanApplication::transitionImageLayout(vk::Image &image, vk::Format format, vk::ImageLayout oldLayout,
                                               vk::ImageLayout newLayout, uint32_t mipLevels)
 {
@@ -8,7 +8,6 @@
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
-#include "Camera.hpp"
 #include "QueueFamilyIndices.hpp"
 #include "VulkanApplication.hpp"
 
@@ -93,17 +92,16 @@ bool VulkanApplication::isDeviceSuitable(const vk::PhysicalDevice &gpu, const vk
 {
     DEBUG_FUNCTION
     auto indices = QueueFamilyIndices::findQueueFamilies(gpu, surface);
-    bool extensionsSupported = checkDeviceExtensionSupport(gpu);
-    vk::PhysicalDeviceProperties deviceProperties = gpu.getProperties();
+    bool extensionsSupported = checkDeviceExtensionSupport(gpu, static_cast<bool>(surface));
     vk::PhysicalDeviceFeatures deviceFeatures = gpu.getFeatures();
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    // Without a surface nothing is presented
+    bool swapChainAdequate = !surface;
+    if (surface && extensionsSupported) {
         auto swapChainSupport = Swapchain::SupportDetails::querySwapChainSupport(gpu, surface);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
-    return indices.isComplete() && extensionsSupported && swapChainAdequate && deviceFeatures.samplerAnisotropy &&
-           deviceProperties.limits.maxPushConstantsSize >= sizeof(Camera::GPUCameraData);
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && deviceFeatures.samplerAnisotropy;
 }
 
 uint32_t VulkanApplication::rateDeviceSuitability(const vk::PhysicalDevice &gpu)
@@ -119,12 +117,22 @@ uint32_t VulkanApplication::rateDeviceSuitability(const vk::PhysicalDevice &gpu)
     return score;
 }
 
-bool VulkanApplication::checkDeviceExtensionSupport(const vk::PhysicalDevice &device)
+std::vector<const char *> VulkanApplication::getDeviceExtensions(bool bPresent)
+{
+    std::vector<const char *> extensions = deviceExtensions;
+    if (!bPresent) {
+        std::erase_if(extensions, [](const char *name) { return strcmp(name, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; });
+    }
+    return extensions;
+}
+
+bool VulkanApplication::checkDeviceExtensionSupport(const vk::PhysicalDevice &device, bool bPresent)
 {
     DEBUG_FUNCTION
     auto availableExtensions = device.enumerateDeviceExtensionProperties();
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    const auto extensions = getDeviceExtensions(bPresent);
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
     for (const auto &extension: availableExtensions) { requiredExtensions.erase(extension.extensionName); }
     return requiredExtensions.empty();
 }
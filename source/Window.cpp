@@ -3,11 +3,15 @@
 #include "DebugMacros.hpp"
 #include <stdexcept>
 
-Window::Window(std::string n, unsigned w, unsigned h): width(w), height(h), windowName(n) { initWindow(); }
+Window::Window(std::string n, unsigned w, unsigned h, bool bHeadless): width(w), height(h), windowName(n)
+{
+    if (!bHeadless) initWindow();
+}
 
 Window::~Window()
 {
-    if (window != nullptr) glfwDestroyWindow(window);
+    if (window == nullptr) return;
+    glfwDestroyWindow(window);
     glfwTerminate();
 }
 
@@ -30,20 +34,30 @@ void Window::initWindow() noexcept
     window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
 }
 
-void Window::setKeyCallback(GLFWkeyfun &&f) noexcept { glfwSetKeyCallback(window, f); }
-void Window::setCursorPosCallback(GLFWcursorposfun &&f) noexcept { glfwSetCursorPosCallback(window, f); }
-void Window::setResizeCallback(GLFWwindowsizefun &&f) noexcept { glfwSetFramebufferSizeCallback(window, f); }
+void Window::setKeyCallback(GLFWkeyfun &&f) noexcept
+{
+    if (window) glfwSetKeyCallback(window, f);
+}
+void Window::setCursorPosCallback(GLFWcursorposfun &&f) noexcept
+{
+    if (window) glfwSetCursorPosCallback(window, f);
+}
+void Window::setResizeCallback(GLFWwindowsizefun &&f) noexcept
+{
+    if (window) glfwSetFramebufferSizeCallback(window, f);
+}
 void Window::unsetKeyCallback() noexcept
 {
-    glfwSetKeyCallback(window, [](GLFWwindow *, int, int, int, int) {});
+    if (window) glfwSetKeyCallback(window, [](GLFWwindow *, int, int, int, int) {});
 }
 void Window::unsetCursorPosCallback() noexcept
 {
-    glfwSetCursorPosCallback(window, [](GLFWwindow *, double, double) {});
+    if (window) glfwSetCursorPosCallback(window, [](GLFWwindow *, double, double) {});
 }
 
 void Window::captureCursor(bool capture) noexcept
 {
+    if (!window) return;
     if (capture) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     } else {
@@ -51,12 +65,15 @@ void Window::captureCursor(bool capture) noexcept
     }
 }
 
-void Window::setUserPointer(void *ptr) noexcept { glfwSetWindowUserPointer(window, ptr); }
+void Window::setUserPointer(void *ptr) noexcept
+{
+    if (window) glfwSetWindowUserPointer(window, ptr);
+}
 
 void Window::setTitle(const std::string &t) noexcept
 {
     windowName = t;
-    glfwSetWindowTitle(window, windowName.c_str());
+    if (window) glfwSetWindowTitle(window, windowName.c_str());
 }
 
 std::vector<const char *> Window::getRequiredExtensions()
@@ -1,10 +1,19 @@
+#include <algorithm>
 #include <exception>
+#include <filesystem>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <stdlib.h>
 
 #include "Application.hpp"
+#include "Benchmark.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
+#include "SceneFile.hpp"
+#include "types/CreationParameters.hpp"
 #include "types/VulkanException.hpp"
 #include <getopt.h>
 
@@ -21,16 +30,49 @@ __attribute__((destructor)) void dtor() { delete logger; }
 
 struct CmdOption {
     bool bVerbose = false;
+    std::optional<std::filesystem::path> scenePath;
+    // Convert a text scene description to the binary format, and exit
+    std::optional<std::filesystem::path> convertPath;
+    // Render this many frames offscreen, without a window, and exit
+    std::optional<uint64_t> headlessFrames;
+    // Replay a camera path, and write the frame time report
+    std::optional<std::filesystem::path> benchmarkPath;
+    std::filesystem::path reportPath = "benchmark.json";
+    // Present mode, swapchain images, frames in flight, low latency, late latch, frame rate limit, simulation rate and
+    // object capacity
+    CreationParameters parameters = {};
 };
 
+static vk::PresentModeKHR parsePresentMode(const std::string &name)
+{
+    if (name == "fifo") return vk::PresentModeKHR::eFifo;
+    if (name == "fifo_relaxed") return vk::PresentModeKHR::eFifoRelaxed;
+    if (name == "mailbox") return vk::PresentModeKHR::eMailbox;
+    if (name == "immediate") return vk::PresentModeKHR::eImmediate;
+    throw std::runtime_error("unknown present mode " + name + ", expected fifo, fifo_relaxed, mailbox or immediate");
+}
+
 CmdOption getCmdLineOption(int ac, char **av)
 {
     CmdOption opt{};
     int c;
 
-    while ((c = getopt(ac, av, "v")) != -1) {
+    while ((c = getopt(ac, av, "vs:c:H:b:o:p:i:f:lLr:t:O:")) != -1) {
         switch (c) {
             case 'v': opt.bVerbose = true; break;
+            case 's': opt.scenePath = optarg; break;
+            case 'c': opt.convertPath = optarg; break;
+            case 'H': opt.headlessFrames = std::stoull(optarg); break;
+            case 'b': opt.benchmarkPath = optarg; break;
+            case 'o': opt.reportPath = optarg; break;
+            case 'p': opt.parameters.presentMode = parsePresentMode(optarg); break;
+            case 'i': opt.parameters.swapchainImageCount = std::stoul(optarg); break;
+            case 'f': opt.parameters.framesInFlight = std::stoul(optarg); break;
+            case 'l': opt.parameters.bLowLatency = true; break;
+            case 'L': opt.parameters.bLateLatchCamera = true; break;
+            case 'r': opt.parameters.maxFrameRate = std::stoul(optarg); break;
+            case 't': opt.parameters.simulationRate = std::stoul(optarg); break;
+            case 'O': opt.parameters.maxObjects = std::stoul(optarg); break;
             default: break;
         }
     }
@@ -42,16 +84,48 @@ int main(int ac, char **av)
 try {
     CmdOption option = getCmdLineOption(ac, av);
     if (option.bVerbose) logger->setLevel(Logger::Level::Debug);
+    // Only a benchmark has an end of its own, otherwise nothing would be rendered
+    if (option.headlessFrames == 0 && !option.benchmarkPath) {
+        throw std::runtime_error("-H 0 renders until the end of the benchmark path, which is given with -b");
+    }
+
+    if (option.convertPath) {
+        auto output = *option.convertPath;
+        output.replace_extension(".scene");
+        SceneFile::convert(*option.convertPath, output);
+        logger->info("SCENE") << "Converted " << *option.convertPath << " to " << output;
+        logger->endl();
+        return EXIT_SUCCESS;
+    }
+
+    std::unique_ptr<Benchmark> benchmark;
+    if (option.benchmarkPath) benchmark = std::make_unique<Benchmark>(*option.benchmarkPath);
 
-    Application app;
+    // The object buffers are created before the scene is loaded, so they are sized from its header
+    if (option.scenePath) {
+        const SceneFile scene(*option.scenePath);
+        option.parameters.maxObjects = std::max(option.parameters.maxObjects, scene.getHeader().objectCount);
+    }
 
-    app.init([&app]() {
+    Application app(option.headlessFrames.has_value(), option.parameters);
+
+    app.init([&app, &option]() {
         app.loadModel();
         app.loadTextures();
+        if (option.scenePath) app.loadScene(*option.scenePath);
         return true;
     });
 
-    app.run();
+    // A headless benchmark runs until the end of its path when no frame count is given
+    std::optional<uint64_t> frameLimit = option.headlessFrames;
+    if (benchmark && frameLimit == 0) frameLimit = std::nullopt;
+    app.run(frameLimit, benchmark.get());
+    if (benchmark) {
+        benchmark->writeReport(option.reportPath);
+        logger->info("BENCHMARK") << "Wrote the report to " << option.reportPath;
+        logger->endl();
+    }
+    PROFILE_DUMP("cpu_trace.json");
     return EXIT_SUCCESS;
 } catch (const VulkanException &se) {
     logger->err("VULKAN_ERROR") << se.what();